@@ -16,6 +16,8 @@
 #include "Special.h"
 #include "PuzzleList.h"
 #include "Watchdog.h"
+#include "PanelSnapshot.h"
+#include "MemoryImage.h"
 #include "Random.h"
 
 #define IDC_RANDOMIZE 0x401
@@ -111,6 +113,7 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT message, WPARAM wParam, LPARAM lParam)
 		return 0;
 	}
 	else if (message == WM_DESTROY) {
+		WatchdogScheduler::stop();
 		PostQuitMessage(0);
 	} else if (message == WM_COMMAND || message == WM_TIMER) {
 		switch (HIWORD(wParam)) {
@@ -186,6 +189,11 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT message, WPARAM wParam, LPARAM lParam)
 			else randomizer->seedIsRNG = false;
 
 			randomizer->ClearOffsets();
+			if (DEBUG && !rerandomize) MemoryImage::StartRecording(); //For the Cli project, which generates against a copy of what gets read here
+			if (rerandomize) {
+				WatchdogScheduler::cancelAll();
+				PanelSnapshot::Restore(); //Start again from the game's own panels instead of on top of the last seed
+			}
 			
 			ShowWindow(hwndLoadingText, SW_SHOW);
 
@@ -278,13 +286,27 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT message, WPARAM wParam, LPARAM lParam)
 			randomizer->seed = seed;
 			randomizer->colorblind = IsDlgButtonChecked(hwnd, IDC_COLORBLIND);
 			randomizer->doubleMode = doubleMode;
-			if (hard) randomizer->GenerateHard(hwndLoadingText);
-			else if (easy) randomizer->GenerateEasy(hwndLoadingText);
-			else randomizer->GenerateNormal(hwndLoadingText);
+			randomizer->version = VERSION_STR;
+			WatchdogScheduler::cancelAll(); //Any restored watchdogs belong to the old puzzles
+			try {
+				if (hard) randomizer->GenerateHard(hwndLoadingText);
+				else if (easy) randomizer->GenerateEasy(hwndLoadingText);
+				else randomizer->GenerateNormal(hwndLoadingText);
+			}
+			catch (const std::runtime_error& e) { //A panel that can't be generated even with its recipe relaxed (see Generate::untilSuccess)
+				std::string message = std::string(e.what()) + "\r\n\r\nPlease try a different seed, and report the seed on the Github Issues page.";
+				MessageBox(hwnd, std::wstring(message.begin(), message.end()).c_str(), L"Randomization failed", MB_OK);
+				SetWindowText(hwndRandomize, L"Randomize");
+				EnableWindow(hwndColorblind, true);
+				EnableWindow(hwndDoubleMode, true);
+				break;
+			}
 			Special::WritePanelData(0x00064, BACKGROUND_REGION_COLOR + 12, seed);
 			Special::WritePanelData(0x00182, BACKGROUND_REGION_COLOR + 12, hard);
 			Special::WritePanelData(0x0A3B5, BACKGROUND_REGION_COLOR + 12, easy);
 			Special::WritePanelData(0x0A3B2, BACKGROUND_REGION_COLOR + 12, doubleMode);
+			if (DEBUG) MemoryImage::SaveRecording("WRPGimage.bin");
+			PanelSnapshot::Save(); //So the panels can still be restored if the randomizer is closed and opened again
 			SetWindowText(hwndRandomize, L"Randomized!");
 			SetWindowText(hwndSeed, std::to_wstring(seed).c_str());
 
@@ -484,12 +506,17 @@ int APIENTRY wWinMain(_In_ HINSTANCE hInstance, _In_opt_ HINSTANCE hPrevInstance
 		}
 	}
 	Memory::showMsg = true;
+	if (DEBUG) WatchdogStats::enable("WRPGstats.txt");
+	if (DEBUG) StageStats::enable("WRPGstages.txt");
 
 	//Get the seed and difficulty previously used for this save file (if applicable)
 	int lastSeed = Special::ReadPanelData<int>(0x00064, BACKGROUND_REGION_COLOR + 12);
 	hard = (Special::ReadPanelData<int>(0x00182, BACKGROUND_REGION_COLOR + 12) > 0);
 	easy = (Special::ReadPanelData<int>(0x0A3B5, BACKGROUND_REGION_COLOR + 12) > 0);
 	doubleMode = (Special::ReadPanelData<int>(0x0A3B2, BACKGROUND_REGION_COLOR + 12) > 0);
+	//If the randomizer was closed while the game kept running, pick up the watchdogs where they left off
+	if (lastSeed > 0) WatchdogScheduler::restore();
+	if (lastSeed > 0) PanelSnapshot::Load();
 
 	//-------------------------Basic window controls---------------------------
 
@@ -4,8 +4,8 @@
 #define TO_STRING(s) TO_STRING2(s)
 
 #define MAJOR 1
-#define MINOR 3
-#define PATCH 7
+#define MINOR 4
+#define PATCH 0
 
 #define VERSION_STR     TO_STRING(MAJOR) "." TO_STRING(MINOR) "." TO_STRING(PATCH)
 #define VERSION			MAJOR, MINOR, PATCH
@@ -0,0 +1,165 @@
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+
+// PVS-Studio Static Code Analyzer for C, C++, C#, and Java: http://www.viva64.com
+
+#include "SyntheticPanel.h"
+#include "Generate.h"
+#include "Special.h"
+#include <chrono>
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <functional>
+#include <algorithm>
+#include <cstdlib>
+
+//Times Generate on one puzzle of each kind of recipe PuzzleList uses. Every run gets a fresh synthetic panel of the recipe's size (see SyntheticPanel),
+//so it needs neither the game nor a recorded image. Usage: WitnessRandomizerBench [runs per recipe] [output csv]
+
+static std::atomic<size_t> allocations = 0;
+
+void* operator new(size_t size) {
+	allocations++;
+	void* ptr = malloc(size > 0 ? size : 1);
+	if (!ptr) throw std::bad_alloc();
+	return ptr;
+}
+void operator delete(void* ptr) noexcept { free(ptr); }
+
+struct Recipe {
+	std::string name;
+	int width, height; //Cells of the synthetic panel the puzzle is made on
+	bool pillar;
+	std::function<void(std::shared_ptr<Generate>, int)> run; //Makes one puzzle on the given panel with a freshly seeded generator
+};
+
+struct Result {
+	std::string name;
+	int runs;
+	double attemptsPerSuccess, meanMillis, p99Millis, allocationsPerPuzzle;
+};
+
+static std::vector<Recipe> recipes()
+{
+	return {
+		{ "stones_2_colors", 5, 5, false, [](std::shared_ptr<Generate> gen, int id) {
+			gen->generate(id, Decoration::Exit, 1, Decoration::Stone | Decoration::Color::Black, 11, Decoration::Stone | Decoration::Color::White, 8);
+		} },
+		{ "stones_4_colors", 5, 5, false, [](std::shared_ptr<Generate> gen, int id) {
+			gen->generate(id, Decoration::Stone | Decoration::Color::Black, 4, Decoration::Stone | Decoration::Color::White, 4,
+				Decoration::Stone | Decoration::Color::Magenta, 3, Decoration::Stone | Decoration::Color::Green, 3);
+		} },
+		{ "shapes_rotate", 4, 4, false, [](std::shared_ptr<Generate> gen, int id) {
+			gen->generate(id, Decoration::Poly | Decoration::Can_Rotate, 1, Decoration::Poly, 1, Decoration::Gap, 6);
+		} },
+		{ "shapes_negative", 4, 4, false, [](std::shared_ptr<Generate> gen, int id) {
+			gen->generate(id, Decoration::Poly, 3, Decoration::Poly | Decoration::Negative, 2);
+		} },
+		{ "stars_eraser", 5, 5, false, [](std::shared_ptr<Generate> gen, int id) {
+			gen->generate(id, Decoration::Star | Decoration::Color::Orange, 6, Decoration::Star | Decoration::Color::Magenta, 5,
+				Decoration::Star | Decoration::Color::Green, 4, Decoration::Eraser | Decoration::Magenta, 1);
+		} },
+		{ "stones_eraser", 4, 4, false, [](std::shared_ptr<Generate> gen, int id) {
+			gen->generate(id, Decoration::Stone | Decoration::Color::White, 4, Decoration::Stone | Decoration::Color::Black, 4,
+				Decoration::Stone | Decoration::Color::Red, 3, Decoration::Eraser | Decoration::Color::Green, 1);
+		} },
+		{ "full_dots", 4, 4, false, [](std::shared_ptr<Generate> gen, int id) {
+			gen->generate(id, Decoration::Dot_Intersection, 25, Decoration::Gap, 4);
+		} },
+		{ "full_dots_shapes", 6, 6, false, [](std::shared_ptr<Generate> gen, int id) {
+			gen->generate(id, Decoration::Dot_Intersection, 49, Decoration::Poly, 1, Decoration::Poly | Decoration::Can_Rotate, 2, Decoration::Poly | Decoration::Negative, 3);
+		} },
+		{ "symmetry_horizontal", 5, 5, false, [](std::shared_ptr<Generate> gen, int id) {
+			gen->setFlag(Generate::Config::StartEdgeOnly);
+			gen->setSymmetry(Panel::Symmetry::Horizontal);
+			gen->generate(id, Decoration::Dot, 8, Decoration::Start, 1, Decoration::Exit, 1);
+		} },
+		{ "symmetry_rotational", 6, 6, false, [](std::shared_ptr<Generate> gen, int id) {
+			gen->setFlag(Generate::Config::StartEdgeOnly);
+			gen->setSymmetry(Panel::Symmetry::Rotational);
+			gen->generate(id, Decoration::Dot | Decoration::Color::Blue, 4, Decoration::Dot | Decoration::Color::Yellow, 2, Decoration::Start, 1, Decoration::Exit, 1);
+		} },
+		{ "pillar", 6, 3, true, [](std::shared_ptr<Generate> gen, int id) {
+			gen->generate(id, Decoration::Dot, 15, Decoration::Gap, 6);
+		} },
+		{ "pillar_symmetry", 6, 4, true, [](std::shared_ptr<Generate> gen, int id) {
+			gen->setSymmetry(Panel::Symmetry::PillarParallel);
+			gen->setSymbol(Decoration::Start, 0, 8); gen->setSymbol(Decoration::Start, 6, 8); //Each start and exit needs a symmetric partner
+			gen->setSymbol(Decoration::Exit, 0, 0); gen->setSymbol(Decoration::Exit, 6, 0);
+			gen->setFlagOnce(Generate::Config::DisableDotIntersection);
+			gen->generate(id, Decoration::Dot, 8);
+		} },
+		{ "multi", 4, 4, false, [](std::shared_ptr<Generate> gen, int id) {
+			Special special(gen);
+			special.generatePivotPanel(id, { 4, 4 }, { { Decoration::Triangle | Decoration::Color::Orange, 3 },{ Decoration::Triangle | Decoration::Color::Magenta, 2 } }, false);
+		} },
+		{ "maze", 12, 12, false, [](std::shared_ptr<Generate> gen, int id) {
+			gen->setFlag(Generate::Config::FullGaps);
+			gen->generateMaze(id);
+		} },
+		{ "maze_symmetry", 6, 6, false, [](std::shared_ptr<Generate> gen, int id) {
+			gen->setSymmetry(Panel::Symmetry::Rotational);
+			gen->setSymbol(Decoration::Start, 0, 12); gen->setSymbol(Decoration::Start, 12, 0);
+			gen->setSymbol(Decoration::Exit, 0, 0); gen->setSymbol(Decoration::Exit, 12, 12);
+			gen->generateMaze(id);
+		} },
+	};
+}
+
+static Result measure(const Recipe& recipe, int runs)
+{
+	std::vector<double> millis;
+	size_t totalAttempts = 0, totalAllocations = 0;
+	for (int i = 0; i < runs; i++) {
+		std::shared_ptr<Generate> gen = std::make_shared<Generate>();
+		gen->seed(i + 1);
+		int id = SyntheticPanel::Create(recipe.width, recipe.height, recipe.pillar);
+		Generate::attempts = 0;
+		size_t allocationsBefore = allocations;
+		auto start = std::chrono::steady_clock::now();
+		recipe.run(gen, id);
+		millis.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+		totalAllocations += allocations - allocationsBefore;
+		totalAttempts += Generate::attempts;
+	}
+	std::sort(millis.begin(), millis.end());
+	double sum = 0;
+	for (double m : millis) sum += m;
+	Result result;
+	result.name = recipe.name;
+	result.runs = runs;
+	result.attemptsPerSuccess = static_cast<double>(totalAttempts) / runs;
+	result.meanMillis = sum / runs;
+	result.p99Millis = millis[min(millis.size() - 1, millis.size() * 99 / 100)];
+	result.allocationsPerPuzzle = static_cast<double>(totalAllocations) / runs;
+	return result;
+}
+
+int main(int argc, char* argv[])
+{
+	int runs = argc > 1 ? max(atoi(argv[1]), 1) : 50;
+	std::string outFile = argc > 2 ? argv[2] : "WRPGbench.csv";
+
+	std::vector<Result> results;
+	std::cout << std::left << std::setw(22) << "recipe" << std::right << std::setw(12) << "attempts" << std::setw(12) << "mean ms" << std::setw(12) << "p99 ms" << std::setw(12) << "allocs" << std::endl;
+	for (const Recipe& recipe : recipes()) {
+		try {
+			results.push_back(measure(recipe, runs));
+		}
+		catch (const std::exception& e) {
+			std::cerr << recipe.name << " failed: " << e.what() << std::endl;
+			return 2;
+		}
+		const Result& r = results.back();
+		std::cout << std::left << std::setw(22) << r.name << std::right << std::fixed << std::setprecision(2) << std::setw(12) << r.attemptsPerSuccess
+			<< std::setw(12) << r.meanMillis << std::setw(12) << r.p99Millis << std::setw(12) << std::setprecision(0) << r.allocationsPerPuzzle << std::endl;
+	}
+
+	//One row per recipe, so runs can be appended to a history and compared
+	std::ofstream out(outFile);
+	out << "recipe,runs,attempts_per_success,mean_ms,p99_ms,allocations_per_puzzle" << std::endl;
+	for (const Result& r : results) {
+		out << r.name << "," << r.runs << "," << r.attemptsPerSuccess << "," << r.meanMillis << "," << r.p99Millis << "," << r.allocationsPerPuzzle << std::endl;
+	}
+	return 0;
+}
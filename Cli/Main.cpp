@@ -0,0 +1,57 @@
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+
+// PVS-Studio Static Code Analyzer for C, C++, C#, and Java: http://www.viva64.com
+
+#include "MemoryImage.h"
+#include "PanelStats.h"
+#include "PuzzleList.h"
+#include "Watchdog.h"
+#include <chrono>
+#include <iostream>
+#include <string>
+
+//Generates a whole island against a recorded memory image instead of the game, for profiling and batch runs.
+//Record an image with the App in debug mode (WRPGimage.bin), then run: WitnessRandomizerCli <image> <seed> [normal|expert|easy] [threads]
+int main(int argc, char* argv[])
+{
+	if (argc < 3) {
+		std::cerr << "Usage: WitnessRandomizerCli <image> <seed> [normal|expert|easy] [threads]" << std::endl;
+		return 1;
+	}
+	if (!MemoryImage::Load(argv[1])) {
+		std::cerr << "Couldn't load memory image " << argv[1] << std::endl;
+		return 1;
+	}
+	int seed = atoi(argv[2]);
+	std::string difficulty = argc > 3 ? argv[3] : "normal";
+	int threads = argc > 4 ? atoi(argv[4]) : 0;
+	if (seed <= 0 || (difficulty != "normal" && difficulty != "expert" && difficulty != "easy")) {
+		std::cerr << "Seed has to be a positive number, and difficulty one of normal, expert or easy" << std::endl;
+		return 1;
+	}
+
+	PuzzleList puzzles;
+	puzzles.setSeed(seed, false, false);
+	puzzles.setThreads(threads);
+	auto start = std::chrono::steady_clock::now();
+	try {
+		if (difficulty == "expert") puzzles.GenerateAllH();
+		else if (difficulty == "easy") puzzles.GenerateAllE();
+		else puzzles.GenerateAllN();
+	}
+	catch (const std::exception& e) {
+		std::cerr << "Generation failed: " << e.what() << std::endl;
+		return 2;
+	}
+	double millis = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	WatchdogScheduler::stop(); //The watchdogs would poll the image forever
+
+	std::cout << "Seed " << seed << " (" << difficulty << "): " << millis << " ms" << std::endl;
+	if (MemoryImage::MissedReads() > 0) {
+		std::cout << MemoryImage::MissedReads() << " reads went outside the image and read as zeroes - record it again with this seed" << std::endl;
+	}
+	for (const PanelStats::Relaxed& relaxed : PanelStats::relaxations()) {
+		std::cout << "Panel 0x" << std::hex << relaxed.panel << std::dec << " was relaxed: " << Generate::relaxationName(static_cast<Generate::Relaxation>(relaxed.step)) << std::endl;
+	}
+	return 0;
+}
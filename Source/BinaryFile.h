@@ -0,0 +1,76 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <fstream>
+#include <iterator>
+#include <cstring>
+
+//The small binary files the randomizer keeps next to itself (see PanelCache and WatchdogRegistry) are fixed-width little-endian ints and raw bytes, written in the order they get used.
+
+struct BinaryWriter {
+	std::ofstream out;
+
+	BinaryWriter(const char* filename) : out(filename, std::ios::binary | std::ios::trunc) { }
+
+	bool isOpen() { return out.is_open(); }
+
+	void writeInt(int value) {
+		out.write(reinterpret_cast<const char*>(&value), sizeof(int));
+	}
+
+	void writeBytes(const void* data, size_t size) {
+		out.write(static_cast<const char*>(data), size);
+	}
+
+	void writeInts(const std::vector<int>& values) {
+		writeInt(static_cast<int>(values.size()));
+		for (int value : values) writeInt(value);
+	}
+};
+
+//Reads from a buffer holding the whole file. Every read is bounds checked, so a truncated or corrupt file just leaves ok false.
+struct BinaryReader {
+	std::vector<char> data;
+	size_t pos;
+	bool ok;
+
+	BinaryReader(const char* filename) : pos(0) {
+		std::ifstream file(filename, std::ios::binary);
+		ok = file.is_open();
+		if (ok) data.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+	}
+
+	int readInt() {
+		int value = 0;
+		readBytes(&value, sizeof(int));
+		return value;
+	}
+
+	void readBytes(void* out, size_t size) {
+		if (!ok || size > data.size() - pos) {
+			ok = false;
+			return;
+		}
+		memcpy(out, &data[pos], size);
+		pos += size;
+	}
+
+	//For counts - a negative count or one too big for what is left of the file means the file is bad
+	int readCount(size_t minItemSize) {
+		int count = readInt();
+		if (count < 0 || count * minItemSize > data.size() - pos) ok = false;
+		return ok ? count : 0;
+	}
+
+	std::vector<int> readInts() {
+		std::vector<int> values(readCount(sizeof(int)));
+		for (int& value : values) value = readInt();
+		return values;
+	}
+
+	bool readMagic(const char magic[4]) {
+		char found[4];
+		readBytes(found, 4);
+		return ok && memcmp(found, magic, 4) == 0;
+	}
+};
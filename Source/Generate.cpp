@@ -6,56 +6,57 @@
 #include "Randomizer.h"
 #include "MultiGenerate.h"
 #include "Special.h"
+#include "PanelStats.h"
 
 void Generate::generate(int id, int symbol, int amount) {
 	PuzzleSymbols symbols({ std::make_pair(symbol, amount) });
-	while (!generate(id, symbols));
+	generate_until_done(id, symbols);
 }
 
 void Generate::generate(int id, int symbol1, int amount1, int symbol2, int amount2) {
 	PuzzleSymbols symbols({ std::make_pair(symbol1, amount1), std::make_pair(symbol2, amount2) });
-	while (!generate(id, symbols));
+	generate_until_done(id, symbols);
 }
 
 void Generate::generate(int id, int symbol1, int amount1,  int symbol2, int amount2, int symbol3, int amount3) {
 	PuzzleSymbols symbols({ std::make_pair(symbol1, amount1), std::make_pair(symbol2, amount2), std::make_pair(symbol3, amount3) });
-	while (!generate(id, symbols));
+	generate_until_done(id, symbols);
 }
 
 void Generate::generate(int id, int symbol1, int amount1, int symbol2, int amount2, int symbol3, int amount3, int symbol4, int amount4) {
 	PuzzleSymbols symbols({ std::make_pair(symbol1, amount1), std::make_pair(symbol2, amount2), std::make_pair(symbol3, amount3), std::make_pair(symbol4, amount4) });
-	while (!generate(id, symbols));
+	generate_until_done(id, symbols);
 }
 
 void Generate::generate(int id, int symbol1, int amount1, int symbol2, int amount2, int symbol3, int amount3, int symbol4, int amount4, int symbol5, int amount5) {
 	PuzzleSymbols symbols({ std::make_pair(symbol1, amount1), std::make_pair(symbol2, amount2), std::make_pair(symbol3, amount3), std::make_pair(symbol4, amount4),  std::make_pair(symbol5, amount5) });
-	while (!generate(id, symbols));
+	generate_until_done(id, symbols);
 }
 
 void Generate::generate(int id, int symbol1, int amount1, int symbol2, int amount2, int symbol3, int amount3, int symbol4, int amount4, int symbol5, int amount5, int symbol6, int amount6) {
 	PuzzleSymbols symbols({ std::make_pair(symbol1, amount1), std::make_pair(symbol2, amount2), std::make_pair(symbol3, amount3), std::make_pair(symbol4, amount4),  std::make_pair(symbol5, amount5), std::make_pair(symbol6, amount6) });
-	while (!generate(id, symbols));
+	generate_until_done(id, symbols);
 }
 
 void Generate::generate(int id, int symbol1, int amount1, int symbol2, int amount2, int symbol3, int amount3, int symbol4, int amount4, int symbol5, int amount5, int symbol6, int amount6, int symbol7, int amount7) {
 	PuzzleSymbols symbols({ std::make_pair(symbol1, amount1), std::make_pair(symbol2, amount2), std::make_pair(symbol3, amount3), std::make_pair(symbol4, amount4),  std::make_pair(symbol5, amount5), std::make_pair(symbol6, amount6), std::make_pair(symbol7, amount7) });
-	while (!generate(id, symbols));
+	generate_until_done(id, symbols);
 }
 
 void Generate::generate(int id, int symbol1, int amount1, int symbol2, int amount2, int symbol3, int amount3, int symbol4, int amount4, int symbol5, int amount5, int symbol6, int amount6, int symbol7, int amount7, int symbol8, int amount8) {
 	PuzzleSymbols symbols({ std::make_pair(symbol1, amount1), std::make_pair(symbol2, amount2), std::make_pair(symbol3, amount3), std::make_pair(symbol4, amount4),  std::make_pair(symbol5, amount5), std::make_pair(symbol6, amount6), std::make_pair(symbol7, amount7), std::make_pair(symbol8, amount8) });
-	while (!generate(id, symbols));
+	generate_until_done(id, symbols);
 }
 
 void Generate::generate(int id, int symbol1, int amount1, int symbol2, int amount2, int symbol3, int amount3, int symbol4, int amount4, int symbol5, int amount5, int symbol6, int amount6, int symbol7, int amount7, int symbol8, int amount8, int symbol9, int amount9) {
 	PuzzleSymbols symbols({ std::make_pair(symbol1, amount1), std::make_pair(symbol2, amount2), std::make_pair(symbol3, amount3), std::make_pair(symbol4, amount4),  std::make_pair(symbol5, amount5), std::make_pair(symbol6, amount6), std::make_pair(symbol7, amount7), std::make_pair(symbol8, amount8), std::make_pair(symbol9, amount9) });
-	while (!generate(id, symbols));
+	generate_until_done(id, symbols);
 }
 
 void Generate::generate(int id, const std::vector<std::pair<int, int>>& symbolVec)
 {
 	PuzzleSymbols symbols(symbolVec);
-	while (!generate(id, symbols));
+	generate_until_done(id, symbols);
 }
 
 //Generate puzzle with multiple solutions. id - id of the puzzle. gens - the generators that will be used to make solutions. symbolVec - pairs of symbols and amounts to use
@@ -86,24 +87,59 @@ std::vector<Point> Generate::_DISCONNECT = { Point(0, 2), Point(0, -2), Point(2,
 	Point(0, 2), Point(0, -2), Point(2, 0), Point(-2, 0), Point(2, 2), Point(2, -2), Point(-2, -2), Point(-2, 2),
 	Point(0, 4), Point(0, -4), Point(4, 0), Point(-4, 0), //Used to make the discontiguous shapes
 };
-std::vector<Point> Generate::_SHAPEDIRECTIONS = { }; //This will eventually be set to one of the above lists
+thread_local std::vector<Point> Generate::_SHAPEDIRECTIONS = { }; //This will eventually be set to one of the above lists
+thread_local int Generate::attempts = 0;
 
 //Make a maze puzzle. The maze will have one solution. id - id of the puzzle
 void Generate::generateMaze(int id) {
-	while (!generate_maze(id, 0, 0));
+	generateMaze(id, 0, 0);
 }
 
 //Make a maze puzzle. The maze will have one solution. id - id of the puzzle. numStarts - how many starts to add (only one will be valid). numExits - how many exits to add. All will work
 //Setting numStarts or numExits to 0 will keep the starts/exits where they originally were, otherwise the starts/exits originally there will be removed and new ones randomly placed.
 void Generate::generateMaze(int id, int numStarts, int numExits)
 {
-	while (!generate_maze(id, numStarts, numExits));
+	untilSuccess(id, [&]() { return generate_maze(id, numStarts, numExits); }, [&](Relaxation step) { return relax(step, nullptr); });
+}
+
+void Generate::untilSuccess(int id, const std::function<bool()>& attempt, const std::function<bool(Relaxation)>& relax)
+{
+	int budget = ATTEMPT_BUDGET;
+	int step = FreshSeed;
+	while (!attempt()) {
+		if (--budget > 0) continue;
+		//FewerSymbols is the last step, so it is taken again for as long as it still changes something
+		while (step <= FewerSymbols && !relax(static_cast<Relaxation>(step))) step++;
+		if (step > FewerSymbols) throw std::runtime_error("Couldn't generate a panel, even with its recipe fully relaxed");
+		PanelStats::recordRelaxation(id, static_cast<Relaxation>(step));
+		if (step < FewerSymbols) step++;
+		budget = RELAXED_BUDGET;
+	}
+}
+
+bool Generate::relax(Relaxation step, PuzzleSymbols* symbols)
+{
+	switch (step) {
+	case FreshSeed:
+		seed(Random::rand());
+		return true;
+	case ShorterPath:
+		if (!hasFlag(LongPath) && !hasFlag(LongestPath)) return false;
+		//Only flags that are set go in the one-time list, since write puts everything in it back
+		if (hasFlag(LongPath)) removeFlagOnce(LongPath);
+		if (hasFlag(LongestPath)) removeFlagOnce(LongestPath);
+		return true;
+	case FewerSymbols:
+		return symbols && symbols->removeOne();
+	}
+	return false;
 }
 
 //Read in default panel data, such as dimensions, symmetry, starts/exits, etc. id - id of the puzzle
 void Generate::initPanel(int id) {
 	if (!_panel) {
-		_panel = std::make_shared<Panel>(id);
+		Random::seedPanel(id); //No-op unless per-panel seeding is on
+		_panel = Panel::FromTemplate(id);
 	}
 	if (_width > 0 && _height > 0 && (_width != _panel->_width || _height != _panel->_height)) {
 		_panel->Resize(Point::pillarWidth ? _width - 1 : _width, _height);
@@ -223,6 +259,7 @@ void Generate::write(int id)
 	erase_path();
 
 	incrementProgress();
+	PanelStats::record(id);
 
 	if (hasFlag(Config::ResetColors)) {
 		_panel->colorMode = Panel::ColorMode::Reset;
@@ -284,8 +321,11 @@ void Generate::write(int id)
 		_oneTimeRemove = 0;
 	}
 	//Manually advance seed by 1 each generation to prevent seeds "funneling" from repeated fails
-	Random::seed(_seed);
-	_seed = Random::rand();
+	if (Random::panelSeedsEnabled()) Random::seedPanel(id); //Whatever comes next only depends on which panel was written, not on how many tries it took
+	else {
+		Random::seed(_seed);
+		_seed = Random::rand();
+	}
 }
 
 //Reset all config flags and persistent settings, including width/height and symmetry.
@@ -308,14 +348,24 @@ void Generate::incrementProgress()
 {
 	_areaTotal++;
 	_genTotal++;
+	if (_progressCounter) (*_progressCounter)++;
 	if (_handle) {
 		int total = (_totalPuzzles == 0 ? _areaPuzzles : _totalPuzzles);
 		if (total == 0) return;
 		std::wstring text = _areaName + L": " + std::to_wstring(_areaTotal) + L"/" + std::to_wstring(_areaPuzzles) + L" (" + std::to_wstring(_genTotal * 100 / total) + L"%)";
-		SetWindowText(_handle, text.c_str());
+		SetStatusText(_handle, text);
 	}
 }
 
+//Update the loading text with the number of puzzles finished by all generators. Called from the thread that owns the loading handle.
+void Generate::showProgress(int genTotal)
+{
+	_genTotal = genTotal;
+	if (!_handle || _totalPuzzles == 0) return;
+	std::wstring text = L"Generating: " + std::to_wstring(_genTotal) + L"/" + std::to_wstring(_totalPuzzles) + L" (" + std::to_wstring(_genTotal * 100 / _totalPuzzles) + L"%)";
+	SetStatusText(_handle, text);
+}
+
 //----------------------Private--------------------------
 
 //Add the point (pos) to the intended solution path, using symmetry if applicable.
@@ -377,6 +427,7 @@ void Generate::init_treehouse_layout()
 //The algorithm works by generating a correct path, then extending lines off of it until the maze is filled.
 bool Generate::generate_maze(int id, int numStarts, int numExits)
 {
+	attempts++;
 	initPanel(id);
 
 	if (numStarts > 0) place_start(numStarts);
@@ -399,12 +450,20 @@ bool Generate::generate_maze(int id, int numStarts, int numExits)
 				return false;
 
 		clear();
+		//A few chances to make a path, like generate gets. A maze that can't be made then runs out of attempts instead of looping here.
+		int fails = 0;
 		if (hasFlag(Generate::Config::ShortPath)) {
 			while (!generate_path_length((_panel->_width + _panel->_height),
-				min((_panel->_width + _panel->_height) * 2, (_panel->_width / 2 + 1) * (_panel->_height / 2 + 1) * 1 / 2))) clear();
+				min((_panel->_width + _panel->_height) * 2, (_panel->_width / 2 + 1) * (_panel->_height / 2 + 1) * 1 / 2))) {
+				if (fails++ > 20) return false;
+				clear();
+			}
 		}
 		while (!generate_path_length((_panel->_width + _panel->_height),
-			min((_panel->_width + _panel->_height) * 2, (_panel->_width / 2 + 1) * (_panel->_height / 2 + 1) * 4 / 5))) clear();
+			min((_panel->_width + _panel->_height) * 2, (_panel->_width / 2 + 1) * (_panel->_height / 2 + 1) * 4 / 5))) {
+			if (fails++ > 20) return false;
+			clear();
+		}
 	}
 	
 	std::set<Point> path = _path; //Backup
@@ -518,6 +577,7 @@ bool Generate::generate_maze(int id, int numStarts, int numExits)
 //if at some point the generator fails to add a symbol while still making the solution correct, the function returns false and must be called again.
 bool Generate::generate(int id, PuzzleSymbols symbols)
 {
+	attempts++;
 	initPanel(id);
 
 	//Multiple erasers are forced to be separate by default. This is because combining them causes unpredictable and inconsistent behavior. 
@@ -599,28 +659,75 @@ bool Generate::place_all_symbols(PuzzleSymbols & symbols)
 			}
 		}
 	}
-	if (numShapes > 0 && !place_shapes(colors, negativeColors, numShapes, numRotate, numNegative) || numShapes == 0 && numNegative > 0)
+	if (numShapes == 0 && numNegative > 0)
 		return false;
 
+	//Each stage can be rolled back and retried on its own, so one bad placement doesn't throw away the path and everything placed before it
+	std::vector<Stage> stages;
+	if (numShapes > 0) stages.push_back({ StageStats::Shapes, [=] { return place_shapes(colors, negativeColors, numShapes, numRotate, numNegative); } });
+
 	_stoneTypes = static_cast<int>(symbols[Decoration::Stone].size());
 	_bisect = true; //This flag helps the generator prevent making two adjacent regions of stones the same color
-	for (std::pair<int, int> s : symbols[Decoration::Stone]) if (!place_stones(s.first & 0xf, s.second))
-		return false;
-	for (std::pair<int, int> s : symbols[Decoration::Triangle]) if (!place_triangles(s.first & 0xf, s.second, s.first >> 16))
-		return false;
-	for (std::pair<int, int> s : symbols[Decoration::Arrow]) if (!place_arrows(s.first & 0xf, s.second, s.first >> 12))
-		return false;
-	for (std::pair<int, int> s : symbols[Decoration::Star]) if (!place_stars(s.first & 0xf, s.second))
+	for (std::pair<int, int> s : symbols[Decoration::Stone]) stages.push_back({ StageStats::Stones, [=] { return place_stones(s.first & 0xf, s.second); } });
+	for (std::pair<int, int> s : symbols[Decoration::Triangle]) stages.push_back({ StageStats::Triangles, [=] { return place_triangles(s.first & 0xf, s.second, s.first >> 16); } });
+	for (std::pair<int, int> s : symbols[Decoration::Arrow]) stages.push_back({ StageStats::Arrows, [=] { return place_arrows(s.first & 0xf, s.second, s.first >> 12); } });
+	for (std::pair<int, int> s : symbols[Decoration::Star]) stages.push_back({ StageStats::Stars, [=] { return place_stars(s.first & 0xf, s.second); } });
+	if (symbols.style == Panel::Style::HAS_STARS && hasFlag(Generate::Config::TreehouseLayout))
+		stages.push_back({ StageStats::StarZigzag, [=] { return checkStarZigzag(_panel); } });
+	if (eraserColors.size() > 0) stages.push_back({ StageStats::Erasers, [=] { return place_erasers(eraserColors, eraseSymbols); } });
+	for (std::pair<int, int> s : symbols[Decoration::Dot]) stages.push_back({ StageStats::Dots, [=] { return place_dots(s.second, (s.first & 0xf), (s.first & ~0xf) == Decoration::Dot_Intersection); } });
+	for (std::pair<int, int> s : symbols[Decoration::Gap]) stages.push_back({ StageStats::Gaps, [=] { return place_gaps(s.second); } });
+
+	//Reject recipes that can't fit before doing any work. Each of these symbols takes one of _openpos. (Shapes can be combined and erasers can go on split points, so they aren't counted.)
+	int numCellSymbols = 0;
+	for (int type : { Decoration::Stone, Decoration::Triangle, Decoration::Arrow, Decoration::Star }) numCellSymbols += symbols.getNum(type);
+	if (numCellSymbols > _openpos.size())
 		return false;
-	if (symbols.style == Panel::Style::HAS_STARS && hasFlag(Generate::Config::TreehouseLayout) && !checkStarZigzag(_panel))
+	if (_parity == -1 && symbols.getNum(Decoration::Dot) > _path.size())
 		return false;
-	if (eraserColors.size() > 0 && !place_erasers(eraserColors, eraseSymbols))
-		return false;
-	for (std::pair<int, int> s : symbols[Decoration::Dot]) if (!place_dots(s.second, (s.first & 0xf), (s.first & ~0xf) == Decoration::Dot_Intersection))
-		return false;
-	for (std::pair<int, int> s : symbols[Decoration::Gap]) if (!place_gaps(s.second))
-		return false;
-	return true;
+
+	return run_stages(stages);
+}
+
+//Run the placement stages in order. A stage that fails is rolled back and retried up to STAGE_RETRIES times before the whole attempt fails.
+bool Generate::run_stages(const std::vector<Stage>& stages)
+{
+	_trail.clear();
+	_trailing = true;
+	bool success = true;
+	for (const Stage& stage : stages) {
+		Checkpoint start = checkpoint();
+		int fails = 0;
+		while (success) {
+			bool placed = stage.run();
+			StageStats::record(_panel->id, stage.type, placed);
+			if (placed) break;
+			rollback(start);
+			if (fails++ >= STAGE_RETRIES) success = false;
+		}
+		if (fails > 0) PanelStats::noteRetries(fails);
+		if (!success) break;
+	}
+	_trailing = false;
+	_trail.clear();
+	return success;
+}
+
+//Undo every logged change made since checkpoint was taken
+void Generate::rollback(const Checkpoint& checkpoint)
+{
+	while (_trail.size() > checkpoint.trailSize) {
+		TrailEntry& entry = _trail.back();
+		if (entry.wasOpen) _openpos.insert(entry.pos);
+		else _panel->_grid[entry.pos.first][entry.pos.second] = entry.value;
+		_trail.pop_back();
+	}
+	_stoneTypes = checkpoint.stoneTypes;
+	_bisect = checkpoint.bisect;
+	_config = checkpoint.config;
+	_oneTimeAdd = checkpoint.oneTimeAdd;
+	_oneTimeRemove = checkpoint.oneTimeRemove;
+	_panel->_style = checkpoint.style;
 }
 
 //Generate a random path for a puzzle with the provided symbols.
@@ -1197,7 +1304,7 @@ bool Generate::place_stones(int color, int amount) {
 			//Put remaining stones wherever they will fit
 			Point pos = pick_random(open2);
 			set(pos, Decoration::Stone | color);
-			_openpos.erase(pos);
+			take_open(pos);
 			open2.erase(pos);
 			amount--;
 			continue;
@@ -1237,7 +1344,7 @@ bool Generate::place_stones(int color, int amount) {
 			}
 		}
 		set(pos, Decoration::Stone | color);
-		_openpos.erase(pos);
+		take_open(pos);
 		amount--;
 		passCount++;
 	}
@@ -1518,7 +1625,7 @@ bool Generate::place_shapes(const std::vector<int>& colors, const std::vector<in
 				amount--;
 			}
 			open2.erase(pos);
-			_openpos.erase(pos);
+			take_open(pos);
 			if (_panel->symmetry && Point::pillarWidth == 0 && originalAmount >= 3) {
 				for (const Point& p : shape) {
 					if (p.first < minx) minx = p.first;
@@ -1571,7 +1678,7 @@ bool Generate::place_stars(int color, int amount)
 		if (open2.size() + count < 2) continue; //Not enough space to get 2 of that color
 		if (count == 0 && amount == 1) continue; //If one star is left, it needs a pair
 		set(pos, Decoration::Star | color);
-		_openpos.erase(pos);
+		take_open(pos);
 		amount--;
 		if (count == 0) { //Add a second star of the same color
 			open2.erase(pos);
@@ -1579,7 +1686,7 @@ bool Generate::place_stars(int color, int amount)
 				return false;
 			pos = pick_random(open2);
 			set(pos, Decoration::Star | color);
-			_openpos.erase(pos);
+			take_open(pos);
 			amount--;
 		}
 	}
@@ -1619,7 +1726,7 @@ bool Generate::place_triangles(int color, int amount, int targetCount)
 	if (_panel->id == 0x033EA) { //Keep Yellow Pressure Plate
 		int count = count_sides({ 1, 3 });
 		set({ 1, 3 }, Decoration::Triangle | color | (count << 16));
-		_openpos.erase({ 1, 3 });
+		take_open({ 1, 3 });
 	}
 	std::set<Point> open = _openpos;
 	int count1 = 0, count2 = 0, count3 = 0;
@@ -1656,7 +1763,7 @@ bool Generate::place_triangles(int color, int amount, int targetCount)
 			count3++;
 		}
 		set(pos, Decoration::Triangle | color | (count << 16));
-		_openpos.erase(pos);
+		take_open(pos);
 		amount--;
 	}
 	return true;
@@ -1698,7 +1805,7 @@ bool Generate::place_arrows(int color, int amount, int targetCount)
 				dir.second < 0 && count == (pos.second + 1) / 2 || dir.second > 0 && count == (_panel->_height - pos.second) / 2 && Random::rand() % 10 > 0)
 				continue; //Make it so that there will be some possible edges that aren't passed, in the vast majority of cases
 			set(pos, Decoration::Arrow | color | (count << 12) | (choice << 16));
-			_openpos.erase(pos);
+			take_open(pos);
 			amount--;
 			break;
 		}
@@ -1829,7 +1936,7 @@ bool Generate::place_erasers(const std::vector<int>& colors, const std::vector<i
 		}
 
 		if (!(toErase & Decoration::Dot)) {
-			_openpos.erase(pos);
+			take_open(pos);
 			open2.erase(pos);
 		}
 		//Place the eraser at a random open point
@@ -1840,7 +1947,7 @@ bool Generate::place_erasers(const std::vector<int>& colors, const std::vector<i
 			pos = { 5, 5 }; //For the puzzle in the cave with a pillar in middle
 		}
 		set(pos, Decoration::Eraser | color);
-		_openpos.erase(pos);
+		take_open(pos);
 		amount--;
 	}
 	return true;
@@ -2,11 +2,14 @@
 #include "Panel.h"
 #include "Randomizer.h"
 #include "PuzzleSymbols.h"
+#include "StageStats.h"
 #include <stdlib.h>
 #include <string>
 #include <time.h>
 #include <set>
 #include <algorithm>
+#include <atomic>
+#include <functional>
 #include "Random.h"
 
 typedef std::set<Point> Shape;
@@ -18,7 +21,7 @@ public:
 	Generate() {
 		_width = _height = 0;
 		_areaTotal = _genTotal = _totalPuzzles = _areaPuzzles = _stoneTypes = 0;
-		_fullGaps = _bisect = _allowNonMatch = false;
+		_fullGaps = _bisect = _allowNonMatch = _trailing = false;
 		_handle = NULL;
 		_panel = NULL;
 		_parity = -1;
@@ -35,7 +38,7 @@ public:
 		DisableReset = 0x40000000, MountainFloorH = 0x80000000
 	};
 	
-	void generate(int id) { PuzzleSymbols symbols({ }); while (!generate(id, symbols)); }
+	void generate(int id) { PuzzleSymbols symbols({ }); generate_until_done(id, symbols); }
 	void generate(int id, int symbol, int amount);
 	void generate(int id, int symbol1, int amount1, int symbol2, int amount2);
 	void generate(int id, int symbol1, int amount1, int symbol2, int amount2, int symbol3, int amount3);
@@ -62,9 +65,9 @@ public:
 	void setGridSize(int width, int height);
 	void setSymmetry(Panel::Symmetry symmetry);
 	void write(int id);
-	void setLoadingHandle(HWND handle) { _handle = handle; }
+	void setLoadingHandle(WindowHandle handle) { _handle = handle; }
 	void setLoadingData(int totalPuzzles) { _totalPuzzles = totalPuzzles; _genTotal = 0; }
-	void setLoadingData(const std::wstring& areaName, int numPuzzles) { _areaName = areaName; _areaPuzzles = numPuzzles; _areaTotal = 0; }
+	void setLoadingData(const std::wstring& areaName, int numPuzzles) { _areaName = areaName; _areaPuzzles = numPuzzles; _areaTotal = 0; Random::seedArea(areaName); }
 	void setFlag(Config option) { _config |= option; };
 	void setFlagOnce(Config option) { _config |= option; _oneTimeAdd |= option; };
 	bool hasFlag(Config option) { return _config & option; };
@@ -73,6 +76,8 @@ public:
 	void resetConfig();
 	void seed(long seed) { Random::seed(seed); _seed = Random::rand(); }
 	void incrementProgress();
+	void setProgressCounter(std::shared_ptr<std::atomic<int>> counter) { _progressCounter = counter; } //Shared between generators running on worker threads
+	void showProgress(int genTotal);
 
 	float pathWidth; //Controls how thick the line is on the puzzle
 	std::vector<Point> hitPoints; //The generated path will be forced to hit these points in order
@@ -80,13 +85,27 @@ public:
 	std::set<Point> blockPos; //Point that must be left open
 	std::set<Point> customPath; 
 	Color arrowColor, backgroundColor, successColor; //For the arrow puzzles
+	static thread_local int attempts; //Number of times a puzzle was started over from a new path on this thread (by any generator). For benchmarks and statistics.
+
+	//The steps a recipe that keeps failing is relaxed by, in order. FewerSymbols is repeated, one symbol at a time, until there is nothing left to take away.
+	enum Relaxation { FreshSeed = 1, ShorterPath, FewerSymbols };
+	static const char* relaxationName(Relaxation step) { return step == FreshSeed ? "fresh seed" : step == ShorterPath ? "shorter path" : "fewer symbols"; }
+	//Call attempt until it succeeds. Each time a budget of attempts runs out, relax is called with the next step of the ladder (skipping steps it returns false for) and the step is recorded in PanelStats.
+	//Throws once every step has been used up, so no panel can keep the randomizer busy forever.
+	static void untilSuccess(int id, const std::function<bool()>& attempt, const std::function<bool(Relaxation)>& relax);
+	//This generator's part of a step: a new random stream, no long path flags until the next write, or one symbol less from symbols (if given)
+	bool relax(Relaxation step, PuzzleSymbols* symbols);
 
 private:
 
 	int get(Point pos) { return _panel->_grid[pos.first][pos.second]; }
-	void set(Point pos, int val) { _panel->_grid[pos.first][pos.second] = val; }
+	void set(Point pos, int val) { set(pos.first, pos.second, val); }
 	int get(int x, int y) { return _panel->_grid[x][y]; }
-	void set(int x, int y, int val) { _panel->_grid[x][y] = val; }
+	void set(int x, int y, int val) {
+		if (_trailing) _trail.push_back({ Point(x, y), _panel->_grid[x][y], false });
+		_panel->_grid[x][y] = val;
+	}
+	void take_open(Point pos) { if (_openpos.erase(pos) && _trailing) _trail.push_back({ pos, 0, true }); } //Remove pos from _openpos
 	int get_symbol_type(int flags) { return flags & 0x700; }
 	void set_path(Point pos);
 	Point get_sym_point(Point pos) { return _panel->get_sym_point(pos); }
@@ -100,10 +119,17 @@ private:
 	template <class T> T pop_random(const std::set<T>& set) { T item = pick_random(set); set.erase(item); return item; }
 	bool on_edge(Point p) { return (Point::pillarWidth == 0 && (p.first == 0 || p.first + 1 == _panel->_width) || p.second == 0 || p.second + 1 == _panel->_height); }
 	bool off_edge(Point p) { return (p.first < 0 || p.first >= _panel->_width || p.second < 0 || p.second >= _panel->_height); }
-	static std::vector<Point> _DIRECTIONS1, _8DIRECTIONS1, _DIRECTIONS2, _8DIRECTIONS2, _SHAPEDIRECTIONS, _DISCONNECT;
+	static std::vector<Point> _DIRECTIONS1, _8DIRECTIONS1, _DIRECTIONS2, _8DIRECTIONS2, _DISCONNECT;
+	static thread_local std::vector<Point> _SHAPEDIRECTIONS; //Per thread, since areas can be generated in parallel
 	bool generate_maze(int id, int numStarts, int numExits);
 	bool generate(int id, PuzzleSymbols symbols); //************************************************************
+	void generate_until_done(int id, PuzzleSymbols& symbols) { untilSuccess(id, [&]() { return generate(id, symbols); }, [&](Relaxation step) { return relax(step, &symbols); }); }
 	bool place_all_symbols(PuzzleSymbols& symbols);
+	struct Stage { StageStats::Stage type; std::function<bool()> run; };
+	bool run_stages(const std::vector<Stage>& stages);
+	struct Checkpoint { size_t trailSize; int stoneTypes; bool bisect; int config, oneTimeAdd, oneTimeRemove, style; };
+	Checkpoint checkpoint() { return { _trail.size(), _stoneTypes, _bisect, _config, _oneTimeAdd, _oneTimeRemove, _panel->_style }; }
+	void rollback(const Checkpoint& checkpoint);
 	bool generate_path(PuzzleSymbols& symbols);
 	bool generate_path_length(int minLength, int maxLength);
 	bool generate_path_length(int minLength) { return generate_path_length(minLength, 10000); };
@@ -157,12 +183,23 @@ private:
 	std::vector<std::vector<Point>> _obstructions;
 	bool colorblind;
 
-	HWND _handle;
+	//Undo trail for the placement stages. While _trailing, every grid write made through set() and every point taken out of _openpos is logged so a failed stage can be rolled back.
+	struct TrailEntry { Point pos; int value; bool wasOpen; };
+	std::vector<TrailEntry> _trail;
+	bool _trailing;
+	static const int STAGE_RETRIES = 3; //Times a failed stage is retried before giving up on the path
+	//Attempts a panel gets before its recipe is first relaxed, then between relaxations. Counted rather than timed, so a seed makes the same puzzles on any machine.
+	static const int ATTEMPT_BUDGET = 2000;
+	static const int RELAXED_BUDGET = 200;
+
+	WindowHandle _handle;
 	int _areaTotal, _genTotal, _areaPuzzles, _totalPuzzles;
+	std::shared_ptr<std::atomic<int>> _progressCounter;
 	std::wstring _areaName;
 
 	friend class PuzzleList;
 	friend class Special;
 	friend class MultiGenerate;
+	friend class GenerateTests;
 };
 
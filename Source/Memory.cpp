@@ -3,104 +3,25 @@
 // PVS-Studio Static Code Analyzer for C, C++, C#, and Java: http://www.viva64.com
 
 #include "Memory.h"
-#include "Memoryapi.h"
-#include <psapi.h>
-#include <tlhelp32.h>
-#include <iostream>
-
-#undef PROCESSENTRY32
-#undef Process32Next
 
 Memory::Memory(const std::string& processName) {
-	// First, get the handle of the process
-	PROCESSENTRY32 entry;
-	entry.dwSize = sizeof(entry);
-	HANDLE snapshot = CreateToolhelp32Snapshot(TH32CS_SNAPPROCESS, 0);
-	while (Process32Next(snapshot, &entry)) {
-		if (processName == entry.szExeFile) {
-			_handle = OpenProcess(PROCESS_ALL_ACCESS, FALSE, entry.th32ProcessID);
-			break;
-		}
-	}
-	if (!_handle) {
-		MessageBox(GetActiveWindow(), L"Process not found in RAM. Please open The Witness and then try again.", NULL, MB_OK);
-		throw std::exception("Unable to find process!");
-	}
-
-	// Next, get the process base address
-	DWORD numModules;
-	std::vector<HMODULE> moduleList(1024);
-	EnumProcessModulesEx(_handle, &moduleList[0], static_cast<DWORD>(moduleList.size()), &numModules, 3);
-
-	std::string name(64, '\0');
-	for (DWORD i = 0; i < numModules / sizeof(HMODULE); i++) {
-		int length = GetModuleBaseNameA(_handle, moduleList[i], &name[0], static_cast<DWORD>(name.size()));
-		name.resize(length);
-		if (processName == name) {
-			_baseAddress = (uintptr_t)moduleList[i];
-			break;
-		}
-	}
-	if (_baseAddress == 0) {
-		throw std::exception("Couldn't find the base process address!");
+	if (MemoryImage::IsLoaded()) {
+		_image = true;
+		_baseAddress = MemoryImage::BaseAddress();
+		return;
 	}
+	OpenGame(processName);
 }
 
 Memory::~Memory() {
-	CloseHandle(_handle);
-}
-
-// Copied from Witness Trainer https://github.com/jbzdarkid/witness-trainer/blob/master/Source/Memory.cpp#L218
-int find(const std::vector<byte> &data, const std::vector<byte> &search) {
-	const byte* dataBegin = &data[0];
-	const byte* searchBegin = &search[0];
-	size_t maxI = data.size() - search.size();
-	size_t maxJ = search.size();
-
-	for (int i=0; i<maxI; i++) {
-		bool match = true;
-		for (size_t j=0; j<maxJ; j++) {
-			if (*(dataBegin + i + j) == *(searchBegin + j)) {
-				continue;
-			}
-			match = false;
-			break;
-		}
-		if (match) return i;
-	}
-	return -1;
-}
-
-int Memory::findGlobals() {
-	const std::vector<byte> scanBytes = {0x74, 0x41, 0x48, 0x85, 0xC0, 0x74, 0x04, 0x48, 0x8B, 0x48, 0x10};
-	#define BUFFER_SIZE 0x10000 // 10 KB
-	std::vector<byte> buff;
-	buff.resize(BUFFER_SIZE + 0x100); // padding in case the sigscan is past the end of the buffer
-
-	for (uintptr_t i = 0; i < 0x500000; i += BUFFER_SIZE) {
-		SIZE_T numBytesWritten;
-		if (!ReadProcessMemory(_handle, reinterpret_cast<void*>(_baseAddress + i), &buff[0], buff.size(), &numBytesWritten)) continue;
-		buff.resize(numBytesWritten);
-		int index = find(buff, scanBytes);
-		if (index == -1) continue;
-
-		index = index + 0x14; // This scan targets a line slightly before the key instruction
-		// (address of next line) + (index interpreted as 4byte int)
-		Memory::GLOBALS = (int)(i + index + 4) + *(int*)&buff[index];
-		break;
-	}
-
-	return Memory::GLOBALS;
+	if (_handle) CloseGame();
 }
 
 void Memory::ThrowError(std::string message) {
-	if (!showMsg) throw std::exception(message.c_str());
-	DWORD exitCode;
-	GetExitCodeProcess(_handle, &exitCode);
-	if (exitCode != STILL_ACTIVE) throw std::exception(message.c_str());
+	if (!showMsg || !GameRunning()) throw std::runtime_error(message);
 	message += "\nPlease close The Witness and try again. If the error persists, please report the issue on the Github Issues page.";
-	MessageBoxA(GetActiveWindow(), message.c_str(), NULL, MB_OK);
-	throw std::exception(message.c_str());
+	ShowMessage(std::wstring(message.begin(), message.end()));
+	throw std::runtime_error(message);
 }
 
 void Memory::ThrowError(const std::vector<int>& offsets, bool rw_flag) {
@@ -119,13 +40,6 @@ void Memory::ThrowError(const std::vector<int>& offsets, bool rw_flag) {
 	}
 }
 
-void Memory::ThrowError() {
-	std::string message(256, '\0');
-	int length = FormatMessageA(4096, nullptr, GetLastError(), 1024, &message[0], static_cast<DWORD>(message.size()), nullptr);
-	message.resize(length);
-	ThrowError(message);
-}
-
 void* Memory::ComputeOffset(std::vector<int> offsets)
 {
 	// Leave off the last offset, since it will be either read/write, and may not be of type unitptr_t.
@@ -140,7 +54,7 @@ void* Memory::ComputeOffset(std::vector<int> offsets)
 		if (search == std::end(_computedAddresses)) {
 			// If the address is not yet computed, then compute it.
 			uintptr_t computedAddress = 0;
-			if (!Read(reinterpret_cast<LPVOID>(cumulativeAddress), &computedAddress, sizeof(uintptr_t))) {
+			if (!Read(reinterpret_cast<void*>(cumulativeAddress), &computedAddress, sizeof(uintptr_t))) {
 				if (!showMsg) throw std::exception();
 				ThrowError(offsets, false);
 			}
@@ -152,6 +66,182 @@ void* Memory::ComputeOffset(std::vector<int> offsets)
 	return reinterpret_cast<void*>(cumulativeAddress + final_offset);
 }
 
+void Memory::BeginStaging(bool stream, size_t maxQueued) {
+	std::shared_ptr<Memory> memory = stream ? std::make_shared<Memory>("witness64_d3d11.exe") : nullptr;
+	if (memory) memory->_direct = true;
+	std::lock_guard<std::mutex> lock(_stagingMutex);
+	_staged.clear();
+	_stagedByPanel.clear();
+	_writeQueue.clear();
+	_maxQueued = max(maxQueued, static_cast<size_t>(1));
+	_writerError = nullptr;
+	_streamDone = false;
+	_streaming = stream;
+	if (stream) _writer = std::thread(&Memory::StreamWrites, memory);
+	_staging = true;
+}
+
+void Memory::CommitStaging() {
+	std::unique_lock<std::mutex> lock(_stagingMutex);
+	if (_streaming) {
+		//Flush barrier: wait for the writer thread to send everything that was queued
+		_streamDone = true;
+		_queueReady.notify_all();
+		lock.unlock();
+		_writer.join();
+		lock.lock();
+		_streaming = false;
+		_staging = false;
+		_staged.clear();
+		_stagedByPanel.clear();
+		if (_writerError) std::rethrow_exception(_writerError);
+		return;
+	}
+	_staging = false;
+	std::vector<StagedWrite> staged;
+	staged.swap(_staged);
+	_stagedByPanel.clear();
+	lock.unlock();
+	ApplyWrites(staged);
+}
+
+std::vector<Memory::StagedWrite> Memory::GetStagedWrites() {
+	std::lock_guard<std::mutex> lock(_stagingMutex);
+	std::vector<StagedWrite> writes;
+	for (const StagedWrite& write : _staged) {
+		if (write.data.size() > 0) writes.push_back(write);
+	}
+	return writes;
+}
+
+void Memory::ApplyWrites(const std::vector<StagedWrite>& writes) {
+	Memory memory("witness64_d3d11.exe");
+	memory._direct = true;
+	//Keep the game's originals of everything about to be overwritten, read a panel at a time
+	std::vector<PanelSnapshot::Field> fields;
+	for (const StagedWrite& write : writes) {
+		if (write.data.size() > 0) fields.push_back({ write.panel, write.offset, write.data.size(), write.isArray, write.capacity });
+	}
+	PanelSnapshot::Capture(memory, fields);
+	for (const StagedWrite& write : writes) {
+		memory.WriteStaged(write);
+	}
+}
+
+void Memory::DiscardStaging() {
+	std::unique_lock<std::mutex> lock(_stagingMutex);
+	if (_streaming) {
+		_writeQueue.clear(); //Whatever the writer already sent stays in the game
+		_streamDone = true;
+		_queueReady.notify_all();
+		lock.unlock();
+		_writer.join();
+		lock.lock();
+		_streaming = false;
+	}
+	_staging = false;
+	_staged.clear();
+	_stagedByPanel.clear();
+}
+
+//Writer thread for streamed staging. Takes writes off the queue in order until CommitStaging says there are no more.
+void Memory::StreamWrites(std::shared_ptr<Memory> memory) {
+	std::unique_lock<std::mutex> lock(_stagingMutex);
+	while (true) {
+		_queueReady.wait(lock, [] { return _writeQueue.size() > 0 || _streamDone; });
+		if (_writeQueue.size() == 0) return;
+		StagedWrite write = _staged[_writeQueue.front()];
+		_writeQueue.pop_front();
+		_queueSpace.notify_all();
+		lock.unlock();
+		try {
+			memory->WriteStaged(write);
+		}
+		catch (...) {
+			lock.lock();
+			_writerError = std::current_exception();
+			_writeQueue.clear();
+			_queueSpace.notify_all();
+			return;
+		}
+		lock.lock();
+	}
+}
+
+//Write a staged entry to the game. Arrays are only reallocated if the original write would have done so.
+void Memory::WriteStaged(const StagedWrite& write) {
+	if (write.data.size() == 0) return; //Replaced by a later write
+	if (!write.isArray) {
+		WritePanelData<byte>(write.panel, write.offset, write.data);
+		return;
+	}
+	std::pair<int, int> key = std::make_pair(write.panel, write.offset);
+	//If this instance already wrote the array, it knows its real size. Otherwise use the size from when the write was staged.
+	if (write.capacity == 0 || !_arraySizes.count(key)) _arraySizes[key] = static_cast<int>(write.capacity);
+	int capacity = _arraySizes[key];
+	WriteArray<byte>(write.panel, write.offset, write.data);
+	_arraySizes[key] = max(capacity, static_cast<int>(write.data.size()));
+}
+
+uint32_t Memory::GetWriteCount(int panel) {
+	std::lock_guard<std::mutex> lock(_writeCountMutex);
+	auto it = _writeCounts.find(panel);
+	return it == _writeCounts.end() ? 0 : it->second;
+}
+
+void Memory::CountWrite(int panel) {
+	std::lock_guard<std::mutex> lock(_writeCountMutex);
+	_writeCounts[panel]++;
+}
+
+void Memory::Stage(int panel, int offset, bool isArray, size_t capacity, const void* data, size_t numBytes) {
+	std::unique_lock<std::mutex> lock(_stagingMutex);
+	if (_streaming) _queueSpace.wait(lock, [] { return _writeQueue.size() < _maxQueued || _writerError; }); //Backpressure
+	std::vector<size_t>& panelWrites = _stagedByPanel[panel];
+	for (auto it = panelWrites.begin(); it != panelWrites.end(); it++) {
+		StagedWrite& old = _staged[*it];
+		if (old.offset != offset || old.isArray != isArray || (!isArray && old.data.size() != numBytes)) continue;
+		//Same write again - drop the old one, but keep the array size the game had before either of them
+		if (isArray && capacity != 0) capacity = old.capacity;
+		old.data.clear();
+		panelWrites.erase(it);
+		break;
+	}
+	const byte* bytes = static_cast<const byte*>(data);
+	_staged.push_back({ panel, offset, isArray, capacity, std::vector<byte>(bytes, bytes + numBytes) });
+	panelWrites.push_back(_staged.size() - 1);
+	if (_streaming && !_writerError) {
+		_writeQueue.push_back(_staged.size() - 1);
+		_queueReady.notify_one();
+	}
+}
+
+//Copy staged data over the buffer. Returns true if the staged data covered all of it.
+bool Memory::ReadStaged(int panel, int offset, bool isArray, void* buffer, size_t numBytes) {
+	std::lock_guard<std::mutex> lock(_stagingMutex);
+	auto search = _stagedByPanel.find(panel);
+	if (search == _stagedByPanel.end()) return false;
+	byte* out = static_cast<byte*>(buffer);
+	bool covered = false;
+	for (size_t index : search->second) {
+		const StagedWrite& write = _staged[index];
+		if (write.isArray != isArray) continue;
+		if (isArray) {
+			if (write.offset != offset) continue;
+			size_t count = min(numBytes, write.data.size());
+			memcpy(out, &write.data[0], count);
+			covered = (count == numBytes);
+			continue;
+		}
+		//Panel data can overlap in any way, so copy just the overlapping bytes
+		int start = max(offset, write.offset);
+		int end = min(offset + static_cast<int>(numBytes), write.offset + static_cast<int>(write.data.size()));
+		if (start >= end) continue;
+		memcpy(out + (start - offset), &write.data[start - write.offset], end - start);
+	}
+	return covered;
+}
+
 int Memory::GLOBALS = 0;
 bool Memory::showMsg = false;
 int Memory::globalsTests[3] = {
@@ -159,3 +249,18 @@ int Memory::globalsTests[3] = {
 	0x62B0A0, //Good Old Games
 	0x5B28C0 //Older Versions
 };
+
+std::atomic<bool> Memory::_staging(false);
+std::vector<Memory::StagedWrite> Memory::_staged;
+std::map<int, std::vector<size_t>> Memory::_stagedByPanel;
+std::mutex Memory::_stagingMutex;
+std::deque<size_t> Memory::_writeQueue;
+size_t Memory::_maxQueued = 4096;
+bool Memory::_streaming = false;
+bool Memory::_streamDone = false;
+std::thread Memory::_writer;
+std::exception_ptr Memory::_writerError;
+std::condition_variable Memory::_queueReady;
+std::condition_variable Memory::_queueSpace;
+std::map<int, uint32_t> Memory::_writeCounts;
+std::mutex Memory::_writeCountMutex;
@@ -5,7 +5,18 @@
 #include <sstream>
 #include <iomanip>
 #include <fstream>
-#include <windows.h>
+#include <mutex>
+#include <atomic>
+#include <deque>
+#include <thread>
+#include <condition_variable>
+#include <stdexcept>
+#include <climits>
+#include <cstring>
+#include <stdint.h>
+#include "Platform.h"
+#include "PanelSnapshot.h"
+#include "MemoryImage.h"
 // https://github.com/erayarslan/WriteProcessMemory-Example
 // http://stackoverflow.com/q/32798185
 // http://stackoverflow.com/q/36018838
@@ -21,9 +32,9 @@ public:
 	Memory& operator=(const Memory& other) = delete;
 
 	template <class T>
-	uintptr_t AllocArray(int id, int numItems) {
-		uintptr_t ptr = reinterpret_cast<uintptr_t>(VirtualAllocEx(_handle, 0, numItems * sizeof(T), MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE));
-		return ptr;
+	uintptr_t AllocArray(int /*id*/, int numItems) {
+		if (_image) return MemoryImage::Alloc(numItems * sizeof(T));
+		return AllocGame(numItems * sizeof(T));
 	}
 
 	template <class T>
@@ -31,22 +42,21 @@ public:
 		return AllocArray<T>(id, static_cast<int>(numItems));
 	}
 
-	bool Read(LPCVOID lpBaseAddress, LPVOID lpBuffer, SIZE_T nSize) {
-		if (!retryOnFail) return ReadProcessMemory(_handle, lpBaseAddress, lpBuffer, nSize, nullptr);
-		for (int i = 0; i < 10000; i++) {
-			if (ReadProcessMemory(_handle, lpBaseAddress, lpBuffer, nSize, nullptr)) {
+	bool Read(const void* address, void* buffer, size_t numBytes) {
+		if (_image) return MemoryImage::Read(reinterpret_cast<uintptr_t>(address), buffer, numBytes);
+		for (int i = 0; i < (retryOnFail ? 10000 : 1); i++) {
+			if (ReadGame(address, buffer, numBytes)) {
+				if (MemoryImage::IsRecording()) MemoryImage::Record(reinterpret_cast<uintptr_t>(address), buffer, numBytes);
 				return true;
 			}
 		}
 		return false;
 	}
 
-	bool Write(LPVOID lpBaseAddress, LPCVOID lpBuffer, SIZE_T nSize) {
-		if (!retryOnFail) return WriteProcessMemory(_handle, lpBaseAddress, lpBuffer, nSize, nullptr);
-		for (int i = 0; i < 10000; i++) {
-			if (WriteProcessMemory(_handle, lpBaseAddress, lpBuffer, nSize, nullptr)) {
-				return true;
-			}
+	bool Write(void* address, const void* buffer, size_t numBytes) {
+		if (_image) return MemoryImage::Write(reinterpret_cast<uintptr_t>(address), buffer, numBytes);
+		for (int i = 0; i < (retryOnFail ? 10000 : 1); i++) {
+			if (WriteGame(address, buffer, numBytes)) return true;
 		}
 		return false;
 	}
@@ -58,13 +68,25 @@ public:
 			//Invalidate cache entry for old array address
 			_computedAddresses.erase(reinterpret_cast<uintptr_t>(ComputeOffset({ GLOBALS, 0x18, panel * 8, offset })));
 		}
+		if (_staging) {
+			std::vector<T> data(size);
+			if (ReadStaged(panel, offset, true, &data[0], sizeof(T) * size)) return data;
+		}
 		_arraySizes[std::make_pair(panel, offset)] = size;
-		return ReadData<T>({ GLOBALS, 0x18, panel * 8, offset, 0 }, size);
+		std::vector<T> data = ReadData<T>({ GLOBALS, 0x18, panel * 8, offset, 0 }, size);
+		if (_staging) ReadStaged(panel, offset, true, &data[0], sizeof(T) * size);
+		return data;
 	}
 
 	template <class T>
 	void WriteArray(int panel, int offset, const std::vector<T>& data) {
 		if (data.size() == 0) return;
+		CountWrite(panel);
+		if (_staging && !_direct) {
+			Stage(panel, offset, true, _arraySizes[std::make_pair(panel, offset)] * sizeof(T), &data[0], sizeof(T) * data.size());
+			return;
+		}
+		PanelSnapshot::CaptureArray(*this, panel, offset, sizeof(T) * data.size(), sizeof(T) * _arraySizes[std::make_pair(panel, offset)]);
 		if (data.size() > _arraySizes[std::make_pair(panel, offset)]) {
 			//Invalidate cache entry for old array address
 			_computedAddresses.erase(reinterpret_cast<uintptr_t>(ComputeOffset({ GLOBALS, 0x18, panel * 8, offset })));
@@ -84,21 +106,66 @@ public:
 	template <class T>
 	std::vector<T> ReadPanelData(int panel, int offset, size_t size) {
 		if (size == 0) return std::vector<T>();
-		return ReadData<T>({ GLOBALS, 0x18, panel * 8, offset }, size);
+		std::vector<T> data = ReadData<T>({ GLOBALS, 0x18, panel * 8, offset }, size);
+		if (_staging) ReadStaged(panel, offset, false, &data[0], sizeof(T) * size);
+		return data;
 	}
 
 	template <class T>
 	T ReadPanelData(int panel, int offset) {
-		return ReadData<T>({ GLOBALS, 0x18, panel * 8, offset }, 1)[0];
+		return ReadPanelData<T>(panel, offset, 1)[0];
 	}
 
 	template <class T>
 	void WritePanelData(int panel, int offset, const std::vector<T>& data) {
+		CountWrite(panel);
+		if (_staging && !_direct) {
+			Stage(panel, offset, false, 0, &data[0], sizeof(T) * data.size());
+			return;
+		}
+		PanelSnapshot::CaptureField(*this, panel, offset, sizeof(T) * data.size());
 		WriteData<T>({ GLOBALS, 0x18, panel * 8, offset }, data);
 	}
 
 	void ClearOffsets() { _computedAddresses = std::map<uintptr_t, uintptr_t>(); }
 
+	//Offset and size of each array of panel that this instance knows the size of, in pairs. WriteArray uses the sizes to tell whether an array has to be reallocated.
+	std::vector<int> GetArraySizes(int panel) {
+		std::vector<int> sizes;
+		for (auto it = _arraySizes.lower_bound(std::make_pair(panel, INT_MIN)); it != _arraySizes.end() && it->first.first == panel; it++) {
+			sizes.push_back(it->first.second);
+			sizes.push_back(it->second);
+		}
+		return sizes;
+	}
+	void SetArraySize(int panel, int offset, int size) { _arraySizes[std::make_pair(panel, offset)] = size; }
+
+	//Identify the game process, e.g. to tell whether saved state is from this run of the game
+	uint32_t GetProcessId();
+	uint64_t GetProcessStartTime();
+
+	//While staging, writes from every Memory instance go into a shared staging image instead of the game, and reads see the staged data.
+	//CommitStaging then writes the whole image to the game in one pass, so the game never renders a half-randomized area.
+	//With stream set, a writer thread sends each write to the game as it comes in instead, and CommitStaging waits for it to catch up.
+	//Writers block once maxQueued writes are waiting, so generation can't run arbitrarily far ahead of the game.
+	static void BeginStaging(bool stream = false, size_t maxQueued = 4096);
+	static void CommitStaging();
+	static void DiscardStaging();
+	static bool IsStaging() { return _staging; }
+	void setDirect(bool direct) { _direct = direct; } //Let this instance's writes bypass staging (reads still see staged data)
+
+	struct StagedWrite {
+		int panel, offset;
+		bool isArray;
+		size_t capacity; //Arrays only: size in bytes of the array already in the game. 0 forces a new one to be allocated.
+		std::vector<byte> data;
+	};
+	//Number of writes to panel so far, from any instance and whether staged or not. Anything read from the panel is still current while this hasn't changed.
+	static uint32_t GetWriteCount(int panel);
+
+	static std::vector<StagedWrite> GetStagedWrites(); //Copy of the current staging image, without the writes that were replaced
+	static void ApplyWrites(const std::vector<StagedWrite>& writes); //Write a staging image (e.g. one loaded from the cache) straight to the game
+
 	static int GLOBALS;
 	static bool showMsg;
 	static int globalsTests[3];
@@ -129,13 +196,44 @@ private:
 	void ThrowError(const std::vector<int>& offsets, bool rw_flag);
 	void ThrowError();
 
+	//The game process itself, in MemoryProcess.cpp. Only Windows can open it - anywhere else the constructor throws unless a MemoryImage is loaded.
+	void OpenGame(const std::string& processName);
+	void CloseGame();
+	bool ReadGame(const void* address, void* buffer, size_t numBytes);
+	bool WriteGame(void* address, const void* buffer, size_t numBytes);
+	uintptr_t AllocGame(size_t numBytes);
+	bool GameRunning();
+
 	void* ComputeOffset(std::vector<int> offsets);
 
+	static void Stage(int panel, int offset, bool isArray, size_t capacity, const void* data, size_t numBytes);
+	static bool ReadStaged(int panel, int offset, bool isArray, void* buffer, size_t numBytes);
+	static void StreamWrites(std::shared_ptr<Memory> memory);
+	void WriteStaged(const StagedWrite& write);
+	static void CountWrite(int panel);
+
+	static std::atomic<bool> _staging;
+	static std::vector<StagedWrite> _staged; //In the order they were written. Entries that were overwritten are left empty.
+	static std::map<int, std::vector<size_t>> _stagedByPanel;
+	static std::mutex _stagingMutex;
+	static std::deque<size_t> _writeQueue; //Indices into _staged, waiting for the writer thread
+	static size_t _maxQueued;
+	static bool _streaming, _streamDone;
+	static std::thread _writer;
+	static std::exception_ptr _writerError;
+	static std::condition_variable _queueReady, _queueSpace;
+	static std::map<int, uint32_t> _writeCounts;
+	static std::mutex _writeCountMutex;
+
 	std::map<uintptr_t, uintptr_t> _computedAddresses;
 	std::map<std::pair<int, int>, int> _arraySizes;
 	uintptr_t _baseAddress = 0;
-	HANDLE _handle = nullptr;
+	void* _handle = nullptr; //Process HANDLE
+	bool _direct = false; //Writes from this instance skip staging. Used for the instances that apply the staged image.
+	bool _image = false; //Reads and writes go to the loaded MemoryImage instead of the game
 
 	friend class Randomizer;
 	friend class Special;
+	friend class PanelSnapshot;
+	friend class MemoryImage;
 };
\ No newline at end of file
@@ -0,0 +1,166 @@
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+
+// PVS-Studio Static Code Analyzer for C, C++, C#, and Java: http://www.viva64.com
+
+#include "MemoryImage.h"
+#include "Memory.h"
+#include "BinaryFile.h"
+#include <cstring>
+
+std::unordered_map<uintptr_t, std::vector<uint8_t>> MemoryImage::_pages;
+std::unordered_map<uintptr_t, std::vector<bool>> MemoryImage::_recorded;
+uintptr_t MemoryImage::_baseAddress = 0;
+uintptr_t MemoryImage::_nextAlloc = 0;
+std::atomic<bool> MemoryImage::_recording = false;
+std::atomic<bool> MemoryImage::_loaded = false;
+std::atomic<size_t> MemoryImage::_missedReads = 0;
+std::mutex MemoryImage::_mutex;
+
+namespace {
+	const char MAGIC[4] = { 'W', 'R', 'P', 'I' };
+}
+
+void MemoryImage::StartRecording()
+{
+	Memory memory("witness64_d3d11.exe");
+	std::lock_guard<std::mutex> lock(_mutex);
+	_pages.clear();
+	_recorded.clear();
+	_baseAddress = memory._baseAddress;
+	_recording = true;
+}
+
+bool MemoryImage::SaveRecording(const char* filename)
+{
+	_recording = false;
+	std::lock_guard<std::mutex> lock(_mutex);
+	_recorded.clear();
+	BinaryWriter out(filename);
+	if (!out.isOpen()) return false;
+	out.writeBytes(MAGIC, 4);
+	out.writeInt(FORMAT_VERSION);
+	out.writeInt(Memory::GLOBALS);
+	uint64_t baseAddress = _baseAddress;
+	out.writeBytes(&baseAddress, sizeof(uint64_t));
+	out.writeInt(static_cast<int>(_pages.size()));
+	for (const auto& [address, data] : _pages) {
+		uint64_t pageAddress = address;
+		out.writeBytes(&pageAddress, sizeof(uint64_t));
+		out.writeBytes(data.data(), PAGE_SIZE);
+	}
+	return true;
+}
+
+void MemoryImage::Record(uintptr_t address, const void* buffer, size_t size)
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	if (!_recording) return;
+	const uint8_t* bytes = static_cast<const uint8_t*>(buffer);
+	while (size > 0) {
+		uintptr_t pageAddress = address & ~(PAGE_SIZE - 1);
+		size_t count = min(size, static_cast<size_t>(pageAddress + PAGE_SIZE - address));
+		std::vector<uint8_t>& data = page(pageAddress);
+		std::vector<bool>& recorded = _recorded[pageAddress];
+		if (recorded.size() == 0) recorded.resize(PAGE_SIZE);
+		for (size_t i = address - pageAddress; i < address - pageAddress + count; i++, bytes++) {
+			if (recorded[i]) continue; //Later reads may see what the randomizer wrote
+			data[i] = *bytes;
+			recorded[i] = true;
+		}
+		address += count;
+		size -= count;
+	}
+}
+
+bool MemoryImage::Load(const char* filename)
+{
+	BinaryReader in(filename);
+	if (!in.readMagic(MAGIC) || in.readInt() != FORMAT_VERSION) return false;
+	int globals = in.readInt();
+	uint64_t baseAddress = 0;
+	in.readBytes(&baseAddress, sizeof(uint64_t));
+	std::unordered_map<uintptr_t, std::vector<uint8_t>> pages;
+	int numPages = in.readCount(sizeof(uint64_t) + PAGE_SIZE);
+	uintptr_t end = 0;
+	for (int i = 0; i < numPages && in.ok; i++) {
+		uint64_t pageAddress = 0;
+		in.readBytes(&pageAddress, sizeof(uint64_t));
+		std::vector<uint8_t>& data = pages[static_cast<uintptr_t>(pageAddress)];
+		data.resize(PAGE_SIZE);
+		in.readBytes(&data[0], PAGE_SIZE);
+		end = max(end, static_cast<uintptr_t>(pageAddress) + PAGE_SIZE);
+	}
+	if (!in.ok) return false;
+
+	std::lock_guard<std::mutex> lock(_mutex);
+	_pages = std::move(pages);
+	_baseAddress = static_cast<uintptr_t>(baseAddress);
+	_nextAlloc = (end + 0xFFFFF) & ~static_cast<uintptr_t>(0xFFFFF); //New arrays go past everything that was recorded
+	_missedReads = 0;
+	Memory::GLOBALS = globals;
+	_loaded = true;
+	return true;
+}
+
+void MemoryImage::LoadBlank(int globals)
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	_pages.clear();
+	_baseAddress = 0x140000000;
+	_nextAlloc = _baseAddress + 0x10000000;
+	_missedReads = 0;
+	Memory::GLOBALS = globals;
+	_loaded = true;
+}
+
+bool MemoryImage::Read(uintptr_t address, void* buffer, size_t size)
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	uint8_t* bytes = static_cast<uint8_t*>(buffer);
+	bool missed = false;
+	while (size > 0) {
+		uintptr_t pageAddress = address & ~(PAGE_SIZE - 1);
+		size_t count = min(size, static_cast<size_t>(pageAddress + PAGE_SIZE - address));
+		auto it = _pages.find(pageAddress);
+		if (it == _pages.end()) {
+			memset(bytes, 0, count);
+			missed = true;
+		}
+		else memcpy(bytes, &it->second[address - pageAddress], count);
+		address += count;
+		bytes += count;
+		size -= count;
+	}
+	if (missed) _missedReads++;
+	return true;
+}
+
+bool MemoryImage::Write(uintptr_t address, const void* buffer, size_t size)
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	const uint8_t* bytes = static_cast<const uint8_t*>(buffer);
+	while (size > 0) {
+		uintptr_t pageAddress = address & ~(PAGE_SIZE - 1);
+		size_t count = min(size, static_cast<size_t>(pageAddress + PAGE_SIZE - address));
+		memcpy(&page(pageAddress)[address - pageAddress], bytes, count);
+		address += count;
+		bytes += count;
+		size -= count;
+	}
+	return true;
+}
+
+uintptr_t MemoryImage::Alloc(size_t size)
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	uintptr_t address = _nextAlloc;
+	_nextAlloc += (max(size, static_cast<size_t>(1)) + 15) & ~static_cast<size_t>(15);
+	return address;
+}
+
+std::vector<uint8_t>& MemoryImage::page(uintptr_t pageAddress)
+{
+	std::vector<uint8_t>& data = _pages[pageAddress];
+	if (data.size() == 0) data.resize(PAGE_SIZE);
+	return data;
+}
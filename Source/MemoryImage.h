@@ -0,0 +1,47 @@
+#pragma once
+#include <vector>
+#include <unordered_map>
+#include <mutex>
+#include <atomic>
+#include <stdint.h>
+
+//A copy of the parts of the game's memory the randomizer reads, so generation can run without the game (see the Cli project).
+//It is recorded from a real run: the first successful read of each byte from the game is kept, so the image holds the game from before the randomizer wrote to it. While an image is loaded, every Memory instance
+//reads and writes the image instead of looking for the game. Anything that wasn't read while recording reads as zeroes.
+class MemoryImage
+{
+public:
+	static void StartRecording();
+	//Stop recording and write the image. Returns false if the file can't be written.
+	static bool SaveRecording(const char* filename);
+	static bool IsRecording() { return _recording; }
+	static void Record(uintptr_t address, const void* buffer, size_t size);
+
+	//Load an image and use it in place of the game from now on. Also sets Memory::GLOBALS to the one it was recorded with.
+	static bool Load(const char* filename);
+	//Use an empty image in place of the game, with Memory::GLOBALS set to globals. Everything reads as zeroes until it is written (see SyntheticPanel).
+	static void LoadBlank(int globals);
+	static bool IsLoaded() { return _loaded; }
+	static uintptr_t BaseAddress() { return _baseAddress; }
+
+	static bool Read(uintptr_t address, void* buffer, size_t size);
+	static bool Write(uintptr_t address, const void* buffer, size_t size);
+	static uintptr_t Alloc(size_t size);
+	//Number of reads that touched memory missing from the image, so a run against an incomplete image can be told apart
+	static size_t MissedReads() { return _missedReads; }
+
+	static const uintptr_t PAGE_SIZE = 0x1000;
+
+private:
+	static std::vector<uint8_t>& page(uintptr_t pageAddress);
+
+	static std::unordered_map<uintptr_t, std::vector<uint8_t>> _pages; //By page address
+	static std::unordered_map<uintptr_t, std::vector<bool>> _recorded; //While recording - which bytes of each page have been read already
+	static uintptr_t _baseAddress;
+	static uintptr_t _nextAlloc;
+	static std::atomic<bool> _recording, _loaded;
+	static std::atomic<size_t> _missedReads;
+	static std::mutex _mutex;
+
+	static const int FORMAT_VERSION = 1;
+};
@@ -0,0 +1,149 @@
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+
+// PVS-Studio Static Code Analyzer for C, C++, C#, and Java: http://www.viva64.com
+
+#include "Memory.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#include <tlhelp32.h>
+
+#undef PROCESSENTRY32
+#undef Process32Next
+
+void Memory::OpenGame(const std::string& processName) {
+	// First, get the handle of the process
+	PROCESSENTRY32 entry;
+	entry.dwSize = sizeof(entry);
+	HANDLE snapshot = CreateToolhelp32Snapshot(TH32CS_SNAPPROCESS, 0);
+	while (Process32Next(snapshot, &entry)) {
+		if (processName == entry.szExeFile) {
+			_handle = OpenProcess(PROCESS_ALL_ACCESS, FALSE, entry.th32ProcessID);
+			break;
+		}
+	}
+	if (!_handle) {
+		ShowMessage(L"Process not found in RAM. Please open The Witness and then try again.");
+		throw std::runtime_error("Unable to find process!");
+	}
+
+	// Next, get the process base address
+	DWORD numModules;
+	std::vector<HMODULE> moduleList(1024);
+	EnumProcessModulesEx(_handle, &moduleList[0], static_cast<DWORD>(moduleList.size()), &numModules, 3);
+
+	std::string name(64, '\0');
+	for (DWORD i = 0; i < numModules / sizeof(HMODULE); i++) {
+		int length = GetModuleBaseNameA(_handle, moduleList[i], &name[0], static_cast<DWORD>(name.size()));
+		name.resize(length);
+		if (processName == name) {
+			_baseAddress = (uintptr_t)moduleList[i];
+			break;
+		}
+	}
+	if (_baseAddress == 0) {
+		throw std::runtime_error("Couldn't find the base process address!");
+	}
+}
+
+void Memory::CloseGame() {
+	CloseHandle(_handle);
+}
+
+bool Memory::ReadGame(const void* address, void* buffer, size_t numBytes) {
+	return ReadProcessMemory(_handle, address, buffer, numBytes, nullptr);
+}
+
+bool Memory::WriteGame(void* address, const void* buffer, size_t numBytes) {
+	return WriteProcessMemory(_handle, address, buffer, numBytes, nullptr);
+}
+
+uintptr_t Memory::AllocGame(size_t numBytes) {
+	return reinterpret_cast<uintptr_t>(VirtualAllocEx(_handle, 0, numBytes, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE));
+}
+
+bool Memory::GameRunning() {
+	DWORD exitCode;
+	return _handle && GetExitCodeProcess(_handle, &exitCode) && exitCode == STILL_ACTIVE;
+}
+
+uint32_t Memory::GetProcessId() {
+	if (!_handle) return 0;
+	return ::GetProcessId(_handle);
+}
+
+uint64_t Memory::GetProcessStartTime() {
+	FILETIME creation, exit, kernel, user;
+	if (!_handle || !GetProcessTimes(_handle, &creation, &exit, &kernel, &user)) return 0;
+	return (static_cast<uint64_t>(creation.dwHighDateTime) << 32) | creation.dwLowDateTime;
+}
+
+void Memory::ThrowError() {
+	std::string message(256, '\0');
+	int length = FormatMessageA(4096, nullptr, GetLastError(), 1024, &message[0], static_cast<DWORD>(message.size()), nullptr);
+	message.resize(length);
+	ThrowError(message);
+}
+
+// Copied from Witness Trainer https://github.com/jbzdarkid/witness-trainer/blob/master/Source/Memory.cpp#L218
+int find(const std::vector<byte> &data, const std::vector<byte> &search) {
+	const byte* dataBegin = &data[0];
+	const byte* searchBegin = &search[0];
+	size_t maxI = data.size() - search.size();
+	size_t maxJ = search.size();
+
+	for (int i=0; i<maxI; i++) {
+		bool match = true;
+		for (size_t j=0; j<maxJ; j++) {
+			if (*(dataBegin + i + j) == *(searchBegin + j)) {
+				continue;
+			}
+			match = false;
+			break;
+		}
+		if (match) return i;
+	}
+	return -1;
+}
+
+int Memory::findGlobals() {
+	const std::vector<byte> scanBytes = {0x74, 0x41, 0x48, 0x85, 0xC0, 0x74, 0x04, 0x48, 0x8B, 0x48, 0x10};
+	#define BUFFER_SIZE 0x10000 // 10 KB
+	std::vector<byte> buff;
+	buff.resize(BUFFER_SIZE + 0x100); // padding in case the sigscan is past the end of the buffer
+
+	for (uintptr_t i = 0; i < 0x500000; i += BUFFER_SIZE) {
+		SIZE_T numBytesWritten;
+		if (!ReadProcessMemory(_handle, reinterpret_cast<void*>(_baseAddress + i), &buff[0], buff.size(), &numBytesWritten)) continue;
+		buff.resize(numBytesWritten);
+		int index = find(buff, scanBytes);
+		if (index == -1) continue;
+
+		index = index + 0x14; // This scan targets a line slightly before the key instruction
+		// (address of next line) + (index interpreted as 4byte int)
+		Memory::GLOBALS = (int)(i + index + 4) + *(int*)&buff[index];
+		break;
+	}
+
+	return Memory::GLOBALS;
+}
+
+#else
+//Reading another process is only done on Windows, where the game runs. Everywhere else Memory only works on a loaded MemoryImage.
+
+void Memory::OpenGame(const std::string& processName) {
+	throw std::runtime_error("The game can only be opened on Windows - load a MemoryImage to generate without it");
+}
+
+void Memory::CloseGame() { }
+bool Memory::ReadGame(const void* address, void* buffer, size_t numBytes) { return false; }
+bool Memory::WriteGame(void* address, const void* buffer, size_t numBytes) { return false; }
+uintptr_t Memory::AllocGame(size_t numBytes) { return 0; }
+bool Memory::GameRunning() { return false; }
+uint32_t Memory::GetProcessId() { return 0; }
+uint64_t Memory::GetProcessStartTime() { return 0; }
+void Memory::ThrowError() { ThrowError(std::string("Error accessing the game")); }
+int Memory::findGlobals() { return Memory::GLOBALS; }
+
+#endif
@@ -10,11 +10,18 @@ void MultiGenerate::generate(int id, const std::vector<std::shared_ptr<Generate>
 {
 	generators = gens;
 	PuzzleSymbols symbols(symbolVec);
-	while (!generate(id, symbols));
+	//Every solution's generator takes the path steps, while the symbols they share are only relaxed once
+	Generate::untilSuccess(id, [&]() { return generate(id, symbols); }, [&](Generate::Relaxation step) {
+		if (step == Generate::FewerSymbols) return symbols.removeOne();
+		bool relaxed = false;
+		for (std::shared_ptr<Generate> g : generators) relaxed = g->relax(step, nullptr) || relaxed;
+		return relaxed;
+	});
 }
 
 bool MultiGenerate::generate(int id, PuzzleSymbols symbols)
 {
+	Generate::attempts++;
 	for (std::shared_ptr<Generate> g : generators) {
 		g->initPanel(id);
 		int fails = 0;
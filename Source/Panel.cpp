@@ -7,12 +7,17 @@
 #include "Memory.h"
 #include "Randomizer.h"
 #include "Watchdog.h"
+#include "PanelCatalog.h"
 #include <sstream>
 #include <fstream>
 
-int Point::pillarWidth = 0;
+thread_local int Point::pillarWidth = 0;
 std::vector<Panel> Panel::generatedPanels;
 std::vector<std::tuple<int, int>> Panel::arrowPuzzles;
+std::mutex Panel::generatedMutex;
+thread_local Panel::Generated* Panel::areaGenerated = nullptr;
+std::map<int, Panel::Template> Panel::templates;
+std::mutex Panel::templateMutex;
 
 template <class T>
 int find(const std::vector<T> &data, T search, size_t startIndex = 0) {
@@ -31,32 +36,56 @@ Panel::Panel(int id) {
 	Read(id);
 }
 
-void Panel::Read() {
-	_width = 2 * _memory->ReadPanelData<int>(id, GRID_SIZE_X) - 1;
-	if (_memory->ReadPanelData<int>(id, IS_CYLINDER)) {
-		_width++;
-		Point::pillarWidth = _width;
-	}
-	else Point::pillarWidth = 0;
-	_height = 2 * _memory->ReadPanelData<int>(id, GRID_SIZE_Y) - 1;
-	if (_width <= 0 || _height <= 0 || _width > 30 || _height > 30) {
-		int numIntersections = _memory->ReadPanelData<int>(id, NUM_DOTS);
-		_width = _height = static_cast<int>(std::round(sqrt(numIntersections))) * 2 - 1;
-	}
-	_grid.resize(_width);
-	for (auto& row : _grid) row.resize(_height);
-	for (int x = 0; x < _width; x++) {
-		for (int y = 0; y < _height; y++) {
-			_grid[x][y] = 0;
+std::shared_ptr<Panel> Panel::FromTemplate(int id) {
+	uint32_t writeCount = Memory::GetWriteCount(id);
+	{
+		std::lock_guard<std::mutex> lock(templateMutex);
+		auto it = templates.find(id);
+		if (it != templates.end() && it->second.writeCount == writeCount) {
+			Point::pillarWidth = it->second.pillarWidth;
+			return std::make_shared<Panel>(*it->second.panel);
 		}
 	}
-	_startpoints.clear();
-	_endpoints.clear();
+	std::shared_ptr<Panel> panel = std::make_shared<Panel>(id);
+	std::lock_guard<std::mutex> lock(templateMutex);
+	templates[id] = { std::make_shared<const Panel>(*panel), writeCount, Point::pillarWidth }; //If the panel was written during the read, the count won't match next time
+	return panel;
+}
+
+void Panel::ClearTemplates() {
+	std::lock_guard<std::mutex> lock(templateMutex);
+	templates.clear();
+}
+
+void Panel::Read() {
+	if (!PanelCatalog::Load(*this)) { //Unmodified panels may have been decoded on an earlier run
+		_width = 2 * _memory->ReadPanelData<int>(id, GRID_SIZE_X) - 1;
+		if (_memory->ReadPanelData<int>(id, IS_CYLINDER)) {
+			_width++;
+			Point::pillarWidth = _width;
+		}
+		else Point::pillarWidth = 0;
+		_height = 2 * _memory->ReadPanelData<int>(id, GRID_SIZE_Y) - 1;
+		if (_width <= 0 || _height <= 0 || _width > 30 || _height > 30) {
+			int numIntersections = _memory->ReadPanelData<int>(id, NUM_DOTS);
+			_width = _height = static_cast<int>(std::round(sqrt(numIntersections))) * 2 - 1;
+		}
+		_grid.resize(_width);
+		for (auto& row : _grid) row.resize(_height);
+		for (int x = 0; x < _width; x++) {
+			for (int y = 0; y < _height; y++) {
+				_grid[x][y] = 0;
+			}
+		}
+		_startpoints.clear();
+		_endpoints.clear();
 
-	_style = _memory->ReadPanelData<int>(id, STYLE_FLAGS);
-	ReadAllData();
-	ReadIntersections();
-	ReadDecorations();
+		_style = _memory->ReadPanelData<int>(id, STYLE_FLAGS);
+		ReadAllData();
+		ReadIntersections();
+		ReadDecorations();
+		PanelCatalog::Record(*this);
+	}
 	pathWidth = 1;
 	_resized = false;
 	colorMode = ColorMode::Default;
@@ -92,6 +121,11 @@ void Panel::Write() {
 	_memory->WritePanelData<int>(id, STYLE_FLAGS, { _style });
 	if (pathWidth != 1) _memory->WritePanelData<float>(id, PATH_WIDTH_SCALE, { pathWidth });
 	_memory->WritePanelData<int>(id, NEEDS_REDRAW, { 1 });
+	if (areaGenerated) {
+		areaGenerated->panels.push_back(*this);
+		return;
+	}
+	std::lock_guard<std::mutex> lock(generatedMutex);
 	generatedPanels.push_back(*this);
 }
 
@@ -331,7 +365,9 @@ void Panel::WriteDecorations() {
 		for (int i = 0; i < decorations.size(); i++) decorations[i] = 0;
 		_memory->WriteArray<int>(id, DECORATION_FLAGS, decorations);
 	}
-	if (arrows) {
+	if (arrows && areaGenerated) areaGenerated->arrowPuzzles.emplace_back(id, Point::pillarWidth);
+	else if (arrows) {
+		std::lock_guard<std::mutex> lock(generatedMutex);
 		arrowPuzzles.emplace_back(id, Point::pillarWidth);
 	}
 }
@@ -369,9 +405,16 @@ void Panel::ReadIntersections() {
 	else if (symmetryData[0] == _width / 2 && intersections[1] == intersections[3]) symmetry = Symmetry::Vertical;
 	else symmetry = Symmetry::Horizontal;
 
+	//Positions in grid units, unrounded. One flat loop with no branches, so it can be vectorized.
+	std::vector<float> gridX(numIntersections), gridY(numIntersections);
+	for (int i = 0; i < numIntersections; i++) {
+		gridX[i] = (intersections[i * 2] - minx) / unitWidth;
+		gridY[i] = (intersections[i * 2 + 1] - miny) / unitHeight;
+	}
+
 	for (int i = 0; i < num_grid_points; i++) {
-		int x = static_cast<int>(std::round((intersections[i * 2] - minx) / unitWidth));
-		int y = _height - 1 - static_cast<int>(std::round((intersections[i * 2 + 1] - miny) / unitHeight));
+		int x = static_cast<int>(std::round(gridX[i]));
+		int y = _height - 1 - static_cast<int>(std::round(gridY[i]));
 		_grid[x][y] = intersectionFlags[i];
 		if (intersectionFlags[i] & IntersectionFlags::STARTPOINT) {
 			_startpoints.push_back({x, y});
@@ -387,70 +430,68 @@ void Panel::ReadIntersections() {
 	int numConnections = _memory->ReadPanelData<int>(id, NUM_CONNECTIONS);
 	std::vector<int> connections_a = _memory->ReadArray<int>(id, DOT_CONNECTION_A, numConnections);
 	std::vector<int> connections_b = _memory->ReadArray<int>(id, DOT_CONNECTION_B, numConnections);
-	//Remove non-existent connections
-	std::vector<std::string> out;
-	for (int i = 0; i < connections_a.size(); i++) {
-		out.push_back("(" + std::to_string(connections_a[i]) + ", " + std::to_string(connections_b[i]) + ")");
-		if (connections_a[i] >= num_grid_points || connections_b[i] >= num_grid_points) continue;
-		int x = static_cast<int>(std::round((intersections[connections_a[i] * 2] - minx) / unitWidth));
-		int y = _height - 1 - static_cast<int>(std::round((intersections[connections_a[i] * 2 + 1] - miny) / unitHeight));
-		int x2 = static_cast<int>(std::round((intersections[connections_b[i] * 2] - minx) / unitWidth));
-		int y2 = _height - 1 - static_cast<int>(std::round((intersections[connections_b[i] * 2 + 1] - miny) / unitHeight));
-		_grid[(x + x2) / 2][(y + y2) / 2] = 0;
+
+	//Adjacency index: the partners of intersection i are neighbors[firstNeighbor[i]] up to neighbors[firstNeighbor[i + 1]], in connection order
+	std::vector<int> firstNeighbor(numIntersections + 1, 0);
+	for (int i = 0; i < numConnections; i++) {
+		int a = connections_a[i], b = connections_b[i];
+		if (a < 0 || a >= numIntersections || b < 0 || b >= numIntersections) continue;
+		firstNeighbor[a + 1]++;
+		firstNeighbor[b + 1]++;
+	}
+	for (int i = 0; i < numIntersections; i++) firstNeighbor[i + 1] += firstNeighbor[i];
+	std::vector<int> neighbors(firstNeighbor[numIntersections]);
+	std::vector<int> fill(firstNeighbor.begin(), firstNeighbor.end() - 1);
+	for (int i = 0; i < numConnections; i++) {
+		int a = connections_a[i], b = connections_b[i];
+		if (a < 0 || a >= numIntersections || b < 0 || b >= numIntersections) continue;
+		//Remove non-existent connections
+		if (a < num_grid_points && b < num_grid_points) {
+			int x = static_cast<int>(std::round(gridX[a])), x2 = static_cast<int>(std::round(gridX[b]));
+			int y = _height - 1 - static_cast<int>(std::round(gridY[a])), y2 = _height - 1 - static_cast<int>(std::round(gridY[b]));
+			_grid[(x + x2) / 2][(y + y2) / 2] = 0;
+		}
+		neighbors[fill[a]++] = b;
+		neighbors[fill[b]++] = a;
 	}
+	auto connected = [&](int a, int b) {
+		return std::find(neighbors.begin() + firstNeighbor[a], neighbors.begin() + firstNeighbor[a + 1], b) != neighbors.begin() + firstNeighbor[a + 1];
+	};
 
 	// Iterate the remaining intersections (endpoints, dots, gaps)
 	for (int i = num_grid_points; i < numIntersections; i++) {
-		float xd = (intersections[i * 2] - minx) / unitWidth;
-		float yd = (intersections[i * 2 + 1] - miny) / unitHeight;
-		int x = std::clamp((int)std::round(xd), 0, _width - 1);
-		int y = _height - 1 - std::clamp((int)std::round(yd), 0, _height - 1);
+		int x = std::clamp((int)std::round(gridX[i]), 0, _width - 1);
+		int y = _height - 1 - std::clamp((int)std::round(gridY[i]), 0, _height - 1);
 		if (intersectionFlags[i] & IntersectionFlags::GAP) {
-			float xd2 = (intersections[i * 2 + 2] - minx) / unitWidth;
-			float yd2 = (intersections[i * 2 + 3] - miny) / unitHeight;
-			x = std::clamp((int)std::round((xd + xd2) / 2), 0, _width - 1);
-			y = _height - 1 - std::clamp((int)std::round((yd + yd2) / 2), 0, _height - 1);
-			bool fake = false;
-			for (int j = 0; j < numConnections; j++) {
-				if (connections_a[j] == i && connections_b[j] == i + 1 ||
-					connections_a[j] == i + 1 && connections_b[j] == i) {
-					//Fake symmetry wall
-					fake = true;
-					_grid[x][y] = 0;
-					i++;
-					break;
-				}
+			x = std::clamp((int)std::round((gridX[i] + gridX[i + 1]) / 2), 0, _width - 1);
+			y = _height - 1 - std::clamp((int)std::round((gridY[i] + gridY[i + 1]) / 2), 0, _height - 1);
+			if (connected(i, i + 1)) {
+				//Fake symmetry wall
+				_grid[x][y] = 0;
+				i++;
+				continue;
 			}
-			if (fake) continue;
 			i++;
 		}
 		if (intersectionFlags[i] & IntersectionFlags::ENDPOINT) {
-			for (int j = 0; j < numConnections; j++) {
-				int location = -1;
-				if (connections_a[j] == i) location = connections_b[j];
-				if (connections_b[j] == i) location = connections_a[j];
-				if (location != -1) {
-					Endpoint::Direction dir = Endpoint::Direction::NONE;
-					if (intersections[2 * i] < intersections[2 * location]) { // Our (i) x coordinate is less than the target's (location)
-						dir = (Endpoint::Direction)(dir | Endpoint::Direction::LEFT);
-					}
-					if (intersections[2 * i] > intersections[2 * location]) {
-						dir = (Endpoint::Direction)(dir | Endpoint::Direction::RIGHT);
-					}
-					if (intersections[2 * i + 1] < intersections[2 * location + 1]) { // y coordinate is 0 (bottom) 1 (top), so this check is reversed.
-						dir = (Endpoint::Direction)(dir | Endpoint::Direction::DOWN);
-					}
-					if (intersections[2 * i + 1] > intersections[2 * location + 1]) {
-						dir = (Endpoint::Direction)(dir | Endpoint::Direction::UP);
-					}
-					xd = (intersections[location * 2] - minx) / unitWidth;
-					yd = (intersections[location * 2 + 1] - miny) / unitHeight;
-					x = std::clamp((int)std::round(xd), 0, _width - 1);
-					y = _height - 1 - std::clamp((int)std::round(yd), 0, _height - 1);
-					_endpoints.emplace_back(Endpoint(x, y, dir, intersectionFlags[i]));
-					break;
-				}
+			if (firstNeighbor[i] == firstNeighbor[i + 1]) continue;
+			int location = neighbors[firstNeighbor[i]];
+			Endpoint::Direction dir = Endpoint::Direction::NONE;
+			if (intersections[2 * i] < intersections[2 * location]) { // Our (i) x coordinate is less than the target's (location)
+				dir = (Endpoint::Direction)(dir | Endpoint::Direction::LEFT);
+			}
+			if (intersections[2 * i] > intersections[2 * location]) {
+				dir = (Endpoint::Direction)(dir | Endpoint::Direction::RIGHT);
 			}
+			if (intersections[2 * i + 1] < intersections[2 * location + 1]) { // y coordinate is 0 (bottom) 1 (top), so this check is reversed.
+				dir = (Endpoint::Direction)(dir | Endpoint::Direction::DOWN);
+			}
+			if (intersections[2 * i + 1] > intersections[2 * location + 1]) {
+				dir = (Endpoint::Direction)(dir | Endpoint::Direction::UP);
+			}
+			x = std::clamp((int)std::round(gridX[location]), 0, _width - 1);
+			y = _height - 1 - std::clamp((int)std::round(gridY[location]), 0, _height - 1);
+			_endpoints.emplace_back(Endpoint(x, y, dir, intersectionFlags[i]));
 		}
 
 		else {
@@ -474,6 +515,14 @@ void Panel::WriteIntersections() {
 	if (Point::pillarWidth) unitWidth = 1.0f / _width;
 	unitHeight = (maxy - miny) / (_height - 1);
 
+	//Each grid point, endpoint and broken segment adds an intersection (two for gaps), and each of those adds about one connection
+	int numGridPoints = ((_width + 1) / 2) * ((_height + 1) / 2);
+	size_t maxIntersections = numGridPoints + _endpoints.size() + 2 * static_cast<size_t>(_width) * _height / 2;
+	intersections.reserve(2 * maxIntersections);
+	intersectionFlags.reserve(maxIntersections);
+	connections_a.reserve(2 * maxIntersections);
+	connections_b.reserve(2 * maxIntersections);
+
 	for (Point p : _startpoints) {
 		_grid[p.first][p.second] |= STARTPOINT;
 	}
@@ -511,10 +560,7 @@ void Panel::WriteIntersections() {
 		}
 	}
 
-	std::vector<std::string> out;
-	for (int i = 0; i < connections_a.size(); i++) {
-		out.push_back(std::to_string(connections_a[i]) + " -> " + std::to_string(connections_b[i]));
-	}
+	index_segments(connections_a, connections_b);
 
 	if (symmetry) {
 		//Rearrange exits to be in symmetric pairs
@@ -581,7 +627,7 @@ void Panel::WriteIntersections() {
 				if (_grid[x][y] & IntersectionFlags::DOT_IS_BLUE || _grid[x][y] & IntersectionFlags::DOT_IS_ORANGE)
 					_style |= IS_2COLOR;
 			}
-			if (locate_segment(x, y, connections_a, connections_b) == -1)
+			if (locate_segment(x, y) == -1)
 				continue;
 			if (_grid[x][y] & IntersectionFlags::GAP) {
 				if (!break_segment_gap(x, y, connections_a, connections_b, intersections, intersectionFlags))
@@ -649,4 +695,5 @@ void Panel::WriteIntersections() {
 		_memory->WritePanelData<int>(id, NUM_COLORED_REGIONS, { static_cast<int>(polygons.size()) / 4 });
 		_memory->WriteArray<int>(id, COLORED_REGIONS, polygons);
 	}
+	_segmentAt.clear();
 }
\ No newline at end of file
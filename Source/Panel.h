@@ -3,6 +3,11 @@
 #include "Randomizer.h"
 #include <stdint.h>
 #include <tuple>
+#include <mutex>
+#include <array>
+#include <map>
+#include <memory>
+#include <cmath>
 
 struct Point {
 	int first;
@@ -15,7 +20,7 @@ struct Point {
 	bool operator==(const Point& p) const { return first == p.first && second == p.second; };
 	bool operator!=(const Point& p) const { return first != p.first || second != p.second; };
 	friend bool operator<(const Point& p1, const Point& p2) { if (p1.first == p2.first) return p1.second < p2.second; return p1.first < p2.first; };
-	static int pillarWidth;
+	static thread_local int pillarWidth; //Per thread, since panels can be generated in parallel
 };
 
 class Decoration
@@ -142,6 +147,11 @@ public:
 	void Write();
 	void Write(int id) { this->id = id; Write(); }
 
+	//A new copy of panel id as it is in the game. The first call for an id reads it, and later calls copy that until something writes to the panel.
+	//Copies share the template's Memory, which is fine because no two areas generate the same panel.
+	static std::shared_ptr<Panel> FromTemplate(int id);
+	static void ClearTemplates(); //Before each randomization, since the game may have changed in between
+
 	void SetSymbol(int x, int y, Decoration::Shape symbol, Decoration::Color color);
 	void SetShape(int x, int y, int shape, bool rotate, bool negative, Decoration::Color color);
 	void ClearSymbol(int x, int y);
@@ -185,7 +195,8 @@ private:
 	void ReadDecorations();
 	void WriteDecorations();
 
-	Point get_sym_point(int x, int y, Symmetry symmetry)
+	//Mirror of (x, y) computed from scratch. get_sym_point looks it up in a table built from this instead.
+	Point calc_sym_point(int x, int y, Symmetry symmetry)
 	{
 		switch (symmetry) {
 		case None: return Point(x, y);
@@ -208,31 +219,39 @@ private:
 		return Point(x, y);
 	}
 
+	//Mirror of every cell for one symmetry, indexed by x * _height + y. Built on first use and thrown away when the panel is resized.
+	const std::vector<Point>& sym_table(Symmetry symmetry) {
+		if (_symTableWidth != _width || _symTableHeight != _height || _symTablePillarWidth != Point::pillarWidth) {
+			for (std::vector<Point>& table : _symTables) table.clear();
+			_symTableWidth = _width; _symTableHeight = _height; _symTablePillarWidth = Point::pillarWidth;
+		}
+		std::vector<Point>& table = _symTables[symmetry];
+		if (table.size() == 0) {
+			table.reserve(_width * _height);
+			for (int x = 0; x < _width; x++) {
+				for (int y = 0; y < _height; y++) table.push_back(calc_sym_point(x, y, symmetry));
+			}
+		}
+		return table;
+	}
+
+	Point get_sym_point(int x, int y, Symmetry symmetry)
+	{
+		if (symmetry == None) return Point(x, y);
+		if (x < 0 || x >= _width || y < 0 || y >= _height) return calc_sym_point(x, y, symmetry);
+		return sym_table(symmetry)[x * _height + y];
+	}
+
 	Point get_sym_point(int x, int y) { return get_sym_point(x, y, symmetry); }
 	Point get_sym_point(Point p) { return get_sym_point(p.first, p.second, symmetry); }
 	Point get_sym_point(Point p, Symmetry symmetry) { return get_sym_point(p.first, p.second, symmetry); }
 	Endpoint::Direction get_sym_dir(Endpoint::Direction direction, Symmetry symmetry) {
-		int dirIndex;
+		int dirIndex = 0;
 		if (direction == Endpoint::Direction::LEFT) dirIndex = 0;
 		if (direction == Endpoint::Direction::RIGHT) dirIndex = 1;
 		if (direction == Endpoint::Direction::UP) dirIndex = 2;
 		if (direction == Endpoint::Direction::DOWN) dirIndex = 3;
-		std::vector<Endpoint::Direction> mapping;
-		switch (symmetry) {
-		case Symmetry::Horizontal: mapping = { Endpoint::Direction::LEFT, Endpoint::Direction::RIGHT, Endpoint::Direction::DOWN, Endpoint::Direction::UP }; break;
-		case Symmetry::Vertical: mapping = { Endpoint::Direction::RIGHT, Endpoint::Direction::LEFT, Endpoint::Direction::UP, Endpoint::Direction::DOWN }; break;
-		case Symmetry::Rotational: mapping = { Endpoint::Direction::RIGHT, Endpoint::Direction::LEFT, Endpoint::Direction::DOWN, Endpoint::Direction::UP }; break;
-		case Symmetry::RotateLeft: mapping = { Endpoint::Direction::DOWN, Endpoint::Direction::UP, Endpoint::Direction::LEFT, Endpoint::Direction::RIGHT }; break;
-		case Symmetry::RotateRight: mapping = { Endpoint::Direction::UP, Endpoint::Direction::DOWN, Endpoint::Direction::RIGHT, Endpoint::Direction::LEFT }; break;
-		case Symmetry::FlipXY: mapping = { Endpoint::Direction::UP, Endpoint::Direction::DOWN, Endpoint::Direction::LEFT, Endpoint::Direction::RIGHT }; break;
-		case Symmetry::FlipNegXY: mapping = { Endpoint::Direction::DOWN, Endpoint::Direction::UP, Endpoint::Direction::RIGHT, Endpoint::Direction::LEFT }; break;
-		case Symmetry::ParallelH: mapping = { Endpoint::Direction::LEFT, Endpoint::Direction::RIGHT, Endpoint::Direction::UP, Endpoint::Direction::DOWN }; break;
-		case Symmetry::ParallelV: mapping = { Endpoint::Direction::LEFT, Endpoint::Direction::RIGHT, Endpoint::Direction::UP, Endpoint::Direction::DOWN }; break;
-		case Symmetry::ParallelHFlip: mapping = { Endpoint::Direction::RIGHT, Endpoint::Direction::LEFT, Endpoint::Direction::UP, Endpoint::Direction::DOWN }; break;
-		case Symmetry::ParallelVFlip: mapping = { Endpoint::Direction::LEFT, Endpoint::Direction::RIGHT, Endpoint::Direction::DOWN, Endpoint::Direction::UP }; break;
-		default: mapping = { Endpoint::Direction::LEFT, Endpoint::Direction::RIGHT, Endpoint::Direction::UP, Endpoint::Direction::DOWN }; break;
-		}
-		return mapping[dirIndex];
+		return SYM_DIRECTIONS[symmetry][dirIndex];
 	}
 	int get_num_grid_points() { return ((_width + 1) / 2) * ((_height + 1) / 2); }
 	int get_num_grid_blocks() { return (_width / 2) * (_height / 2);  }
@@ -314,31 +333,45 @@ private:
 		return rowsFromBottom * width2 + (x - 1)/2;
 	}
 
-	int locate_segment(int x, int y, std::vector<int>& connections_a, std::vector<int>& connections_b) {
-		for (int i = 0; i < connections_a.size(); i++) {
-			std::pair<int,int> coord1 = loc_to_xy(connections_a[i]);
-			std::pair<int,int> coord2 = loc_to_xy(connections_b[i]);
-			int x1 = coord1.first, y1 = coord1.second, x2 = coord2.first, y2 = coord2.second;
-			if (Point::pillarWidth) {
-				if ((x1 == (x - 1 + Point::pillarWidth) % Point::pillarWidth && x2 == (x + 1) % Point::pillarWidth && y1 == y && y2 == y) ||
-					(y1 == y - 1 && y2 == y + 1 && x1 == x && x2 == x)) {
-					return i;
-				}
+	//Map each grid segment to the connection that spans it, so that breaking segments for dots and gaps doesn't have to search the connections.
+	//Only connections between two grid points span a segment, and a segment stops being spanned once it is broken.
+	void index_segments(const std::vector<int>& connections_a, const std::vector<int>& connections_b) {
+		_segmentAt.assign(_width * _height, -1);
+		for (int i = static_cast<int>(connections_a.size()) - 1; i >= 0; i--) { //Backwards, so the first matching connection wins
+			auto [x1, y1] = loc_to_xy(connections_a[i]);
+			auto [x2, y2] = loc_to_xy(connections_b[i]);
+			int x, y;
+			if (y1 == y2 && (Point::pillarWidth ? x2 == (x1 + 2) % Point::pillarWidth : x2 == x1 + 2)) {
+				x = Point::pillarWidth ? (x1 + 1) % Point::pillarWidth : x1 + 1;
+				y = y1;
 			}
-			else if ((x1 == x - 1 && x2 == x + 1 && y1 == y && y2 == y) ||
-				(y1 == y - 1 && y2 == y + 1 && x1 == x && x2 == x)) {
-				return i;
+			else if (x1 == x2 && y2 == y1 + 2) {
+				x = x1;
+				y = y1 + 1;
 			}
-			
+			else continue;
+			if (x >= 0 && x < _width && y >= 0 && y < _height) _segmentAt[x * _height + y] = i;
 		}
-		return -1;
+	}
+
+	//Index into _segmentAt, or -1 if (x, y) is off the grid
+	int segment_cell(int x, int y) {
+		if (Point::pillarWidth) x = (x + Point::pillarWidth) % Point::pillarWidth;
+		if (x < 0 || x >= _width || y < 0 || y >= _height || _segmentAt.size() == 0) return -1;
+		return x * _height + y;
+	}
+
+	int locate_segment(int x, int y) {
+		int cell = segment_cell(x, y);
+		return cell == -1 ? -1 : _segmentAt[cell];
 	}
 
 	bool break_segment(int x, int y, std::vector<int>& connections_a, std::vector<int>& connections_b, std::vector<float>& intersections, std::vector<int>& intersectionFlags) {
-		int i = locate_segment(x, y, connections_a, connections_b);
+		int i = locate_segment(x, y);
 		if (i == -1) {
 			return false;
 		}
+		_segmentAt[segment_cell(x, y)] = -1; //The pieces don't span it any more
 		int other_connection = connections_b[i];
 		connections_b[i] = static_cast<int>(intersectionFlags.size());
 		connections_a.push_back(static_cast<int>(intersectionFlags.size()));
@@ -350,10 +383,11 @@ private:
 	}
 
 	bool break_segment_gap(int x, int y, std::vector<int>& connections_a, std::vector<int>& connections_b, std::vector<float>& intersections, std::vector<int>& intersectionFlags) {
-		int i = locate_segment(x, y, connections_a, connections_b);
+		int i = locate_segment(x, y);
 		if (i == -1) {
 			return false;
 		}
+		_segmentAt[segment_cell(x, y)] = -1; //The pieces don't span it any more
 		int other_connection = connections_b[i];
 		connections_b[i] = static_cast<int>(intersectionFlags.size() + 1);
 		connections_a.push_back(other_connection);
@@ -429,6 +463,9 @@ private:
 	std::vector<std::vector<int>> _grid;
 	std::vector<Point> _startpoints;
 	std::vector<Endpoint> _endpoints;
+	std::vector<int> _segmentAt; //See index_segments. Only valid during WriteIntersections.
+	std::array<std::vector<Point>, 16> _symTables; //See sym_table
+	int _symTableWidth = 0, _symTableHeight = 0, _symTablePillarWidth = 0;
 	float minx, miny, maxx, maxy, unitWidth, unitHeight;
 	int _style;
 	bool _resized;
@@ -436,11 +473,54 @@ private:
 
 	static std::vector<Panel> generatedPanels;
 	static std::vector<std::tuple<int, int>> arrowPuzzles;
+	static std::mutex generatedMutex; //Guards the two lists above when areas are generated in parallel
+
+	//What one area task generated. While a task has one set, panels go to it instead of the lists above, and PuzzleList::GenerateAreas merges them in area order afterwards,
+	//so the order of the lists doesn't depend on which thread finished first.
+	struct Generated {
+		std::vector<Panel> panels;
+		std::vector<std::tuple<int, int>> arrowPuzzles;
+		std::vector<std::vector<int>> watchdogs; //Records of watchdogs started while Watchdog is recording
+	};
+	static thread_local Generated* areaGenerated;
+
+	struct Template {
+		std::shared_ptr<const Panel> panel;
+		uint32_t writeCount; //Memory::GetWriteCount when it was read
+		int pillarWidth; //Point::pillarWidth, which Read sets
+	};
+	static std::map<int, Template> templates;
+	static std::mutex templateMutex;
+
+	//Mirror of LEFT, RIGHT, UP, DOWN for each symmetry
+	static constexpr Endpoint::Direction SYM_DIRECTIONS[16][4] = {
+		{ Endpoint::Direction::LEFT, Endpoint::Direction::RIGHT, Endpoint::Direction::UP, Endpoint::Direction::DOWN }, //None
+		{ Endpoint::Direction::LEFT, Endpoint::Direction::RIGHT, Endpoint::Direction::DOWN, Endpoint::Direction::UP }, //Horizontal
+		{ Endpoint::Direction::RIGHT, Endpoint::Direction::LEFT, Endpoint::Direction::UP, Endpoint::Direction::DOWN }, //Vertical
+		{ Endpoint::Direction::RIGHT, Endpoint::Direction::LEFT, Endpoint::Direction::DOWN, Endpoint::Direction::UP }, //Rotational
+		{ Endpoint::Direction::DOWN, Endpoint::Direction::UP, Endpoint::Direction::LEFT, Endpoint::Direction::RIGHT }, //RotateLeft
+		{ Endpoint::Direction::UP, Endpoint::Direction::DOWN, Endpoint::Direction::RIGHT, Endpoint::Direction::LEFT }, //RotateRight
+		{ Endpoint::Direction::UP, Endpoint::Direction::DOWN, Endpoint::Direction::LEFT, Endpoint::Direction::RIGHT }, //FlipXY
+		{ Endpoint::Direction::DOWN, Endpoint::Direction::UP, Endpoint::Direction::RIGHT, Endpoint::Direction::LEFT }, //FlipNegXY
+		{ Endpoint::Direction::LEFT, Endpoint::Direction::RIGHT, Endpoint::Direction::UP, Endpoint::Direction::DOWN }, //ParallelH
+		{ Endpoint::Direction::LEFT, Endpoint::Direction::RIGHT, Endpoint::Direction::UP, Endpoint::Direction::DOWN }, //ParallelV
+		{ Endpoint::Direction::RIGHT, Endpoint::Direction::LEFT, Endpoint::Direction::UP, Endpoint::Direction::DOWN }, //ParallelHFlip
+		{ Endpoint::Direction::LEFT, Endpoint::Direction::RIGHT, Endpoint::Direction::DOWN, Endpoint::Direction::UP }, //ParallelVFlip
+		{ Endpoint::Direction::LEFT, Endpoint::Direction::RIGHT, Endpoint::Direction::UP, Endpoint::Direction::DOWN }, //PillarParallel
+		{ Endpoint::Direction::LEFT, Endpoint::Direction::RIGHT, Endpoint::Direction::UP, Endpoint::Direction::DOWN }, //PillarHorizontal
+		{ Endpoint::Direction::LEFT, Endpoint::Direction::RIGHT, Endpoint::Direction::UP, Endpoint::Direction::DOWN }, //PillarVertical
+		{ Endpoint::Direction::LEFT, Endpoint::Direction::RIGHT, Endpoint::Direction::UP, Endpoint::Direction::DOWN }, //PillarRotational
+	};
 
 	friend class PanelExtractionTests;
+	friend class PanelSegmentTests;
+	friend class GenerateTests;
 	friend class Generate;
 	friend class PuzzleList;
+	friend class PanelCatalog;
 	friend class Special;
 	friend class MultiGenerate;
 	friend class ArrowWatchdog;
+	friend class Watchdog;
+	friend class SyntheticPanel;
 };
\ No newline at end of file
@@ -0,0 +1,81 @@
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+
+// PVS-Studio Static Code Analyzer for C, C++, C#, and Java: http://www.viva64.com
+
+#include "PanelCache.h"
+#include "BinaryFile.h"
+
+const char* PanelCache::FILENAME = "WRPGcache.bin";
+
+namespace {
+	const char MAGIC[4] = { 'W', 'R', 'P', 'C' };
+}
+
+bool PanelCache::Load(const Key& key, Entry& entry)
+{
+	BinaryReader in(FILENAME);
+	if (!in.readMagic(MAGIC) || in.readInt() != FORMAT_VERSION) return false;
+	Key fileKey;
+	fileKey.seed = in.readInt();
+	fileKey.difficulty = in.readInt();
+	int flags = in.readInt();
+	fileKey.colorblind = (flags & 1) != 0;
+	fileKey.doubleMode = (flags & 2) != 0;
+	fileKey.freshSave = (flags & 4) != 0;
+	fileKey.globals = in.readInt();
+	fileKey.version.resize(in.readCount(1));
+	if (fileKey.version.size() > 0) in.readBytes(&fileKey.version[0], fileKey.version.size());
+	if (!in.ok || !(fileKey == key)) return false;
+
+	Entry result;
+	result.writes.resize(in.readCount(5 * sizeof(int)));
+	for (Memory::StagedWrite& write : result.writes) {
+		write.panel = in.readInt();
+		write.offset = in.readInt();
+		write.isArray = in.readInt() != 0;
+		write.capacity = in.readInt();
+		write.data.resize(in.readCount(1));
+		if (write.data.size() > 0) in.readBytes(&write.data[0], write.data.size());
+	}
+	int numArrows = in.readCount(2 * sizeof(int));
+	for (int i = 0; i < numArrows; i++) {
+		int id = in.readInt();
+		result.arrowPuzzles.emplace_back(id, in.readInt());
+	}
+	result.watchdogs.resize(in.readCount(sizeof(int)));
+	for (std::vector<int>& record : result.watchdogs) record = in.readInts();
+	if (!in.ok) return false;
+	entry = std::move(result);
+	return true;
+}
+
+void PanelCache::Save(const Key& key, const Entry& entry)
+{
+	BinaryWriter out(FILENAME);
+	if (!out.isOpen()) return; //The cache is only an optimization
+	out.writeBytes(MAGIC, 4);
+	out.writeInt(FORMAT_VERSION);
+	out.writeInt(key.seed);
+	out.writeInt(key.difficulty);
+	out.writeInt((key.colorblind ? 1 : 0) | (key.doubleMode ? 2 : 0) | (key.freshSave ? 4 : 0));
+	out.writeInt(key.globals);
+	out.writeInt(static_cast<int>(key.version.size()));
+	out.writeBytes(key.version.data(), key.version.size());
+
+	out.writeInt(static_cast<int>(entry.writes.size()));
+	for (const Memory::StagedWrite& write : entry.writes) {
+		out.writeInt(write.panel);
+		out.writeInt(write.offset);
+		out.writeInt(write.isArray ? 1 : 0);
+		out.writeInt(static_cast<int>(write.capacity));
+		out.writeInt(static_cast<int>(write.data.size()));
+		out.writeBytes(write.data.data(), write.data.size());
+	}
+	out.writeInt(static_cast<int>(entry.arrowPuzzles.size()));
+	for (const auto& [id, pillarWidth] : entry.arrowPuzzles) {
+		out.writeInt(id);
+		out.writeInt(pillarWidth);
+	}
+	out.writeInt(static_cast<int>(entry.watchdogs.size()));
+	for (const std::vector<int>& record : entry.watchdogs) out.writeInts(record);
+}
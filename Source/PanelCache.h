@@ -0,0 +1,42 @@
+#pragma once
+#include "Memory.h"
+#include <string>
+#include <vector>
+#include <tuple>
+#include <stdint.h>
+
+//Cache of a finished randomization on disk, so randomizing again with the same seed (e.g. after restarting the game) just replays the writes.
+//Everything is stored as fixed-width little-endian ints followed by raw bytes, in the order it gets used, so the file can be read (or mapped) in one go.
+class PanelCache
+{
+public:
+	struct Key {
+		int seed;
+		int difficulty;
+		bool colorblind;
+		bool doubleMode;
+		bool freshSave; //Some writes (e.g. powering off doors) only happen on a save that hasn't been randomized before
+		int globals; //Differs between game builds
+		std::string version;
+
+		bool operator==(const Key& other) const {
+			return seed == other.seed && difficulty == other.difficulty && colorblind == other.colorblind && doubleMode == other.doubleMode &&
+				freshSave == other.freshSave && globals == other.globals && version == other.version;
+		}
+	};
+
+	struct Entry {
+		std::vector<Memory::StagedWrite> writes;
+		std::vector<std::tuple<int, int>> arrowPuzzles;
+		std::vector<std::vector<int>> watchdogs; //See Watchdog::getRecord
+	};
+
+	//Returns false if there is no cache file, it is unreadable, or it was made with a different key
+	static bool Load(const Key& key, Entry& entry);
+	static void Save(const Key& key, const Entry& entry);
+
+	static const char* FILENAME;
+
+private:
+	static const int FORMAT_VERSION = 3;
+};
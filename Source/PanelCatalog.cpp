@@ -0,0 +1,213 @@
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+
+// PVS-Studio Static Code Analyzer for C, C++, C#, and Java: http://www.viva64.com
+
+#include "PanelCatalog.h"
+#include "Panel.h"
+#include "Memory.h"
+#include "BinaryFile.h"
+
+const char* PanelCatalog::FILENAME = "WRPGpanels.bin";
+
+std::map<int, PanelCatalog::Entry> PanelCatalog::_entries;
+std::set<int> PanelCatalog::_checked;
+PanelCatalog::Key PanelCatalog::_key;
+uint32_t PanelCatalog::_processId = 0;
+uint64_t PanelCatalog::_processStart = 0;
+bool PanelCatalog::_lookup = false;
+bool PanelCatalog::_recording = false;
+bool PanelCatalog::_changed = false;
+std::mutex PanelCatalog::_mutex;
+
+namespace {
+	const char MAGIC[4] = { 'W', 'R', 'P', 'N' };
+	const int HEADER_FIELDS[] = { IS_CYLINDER, NUM_DOTS, NUM_CONNECTIONS, NUM_DECORATIONS, GRID_SIZE_X, GRID_SIZE_Y, STYLE_FLAGS };
+	const int HEADER_START = IS_CYLINDER, HEADER_END = STYLE_FLAGS + sizeof(int);
+}
+
+//The file also holds the game process the randomizer last wrote to, so a catalog is never used (or recorded) against panels an earlier run changed
+void PanelCatalog::Begin(const std::string& version)
+{
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_lookup = _recording = false;
+	}
+	Memory memory("witness64_d3d11.exe");
+	Key key = { Memory::GLOBALS, version };
+	uint32_t processId = memory.GetProcessId();
+	uint64_t processStart = memory.GetProcessStartTime();
+
+	std::map<int, Entry> entries;
+	BinaryReader in(FILENAME);
+	bool valid = in.readMagic(MAGIC) && in.readInt() == FORMAT_VERSION;
+	Key fileKey;
+	fileKey.globals = in.readInt();
+	fileKey.version.resize(in.readCount(1));
+	if (fileKey.version.size() > 0) in.readBytes(&fileKey.version[0], fileKey.version.size());
+	uint32_t fileProcessId = static_cast<uint32_t>(in.readInt());
+	uint64_t fileProcessStart = 0;
+	in.readBytes(&fileProcessStart, sizeof(uint64_t));
+	valid = valid && in.ok;
+	if (valid && fileProcessId == processId && fileProcessStart == processStart)
+		return; //The panels may already be randomized
+	if (valid && fileKey.globals == key.globals && fileKey.version == key.version) {
+		int numEntries = in.readCount(14 * sizeof(int));
+		for (int i = 0; i < numEntries && in.ok; i++) {
+			int id = in.readInt();
+			Entry& entry = entries[id];
+			entry.width = in.readInt();
+			entry.height = in.readInt();
+			entry.pillarWidth = in.readInt();
+			entry.style = in.readInt();
+			entry.symmetry = in.readInt();
+			in.readBytes(&entry.minx, sizeof(float) * 6);
+			entry.grid = in.readInts();
+			entry.startpoints = in.readInts();
+			entry.endpoints = in.readInts();
+			entry.arraySizes = in.readInts();
+			in.readBytes(&entry.header, sizeof(uint64_t));
+			if (entry.width <= 0 || entry.height <= 0 || entry.grid.size() != entry.width * entry.height) in.ok = false;
+		}
+		if (!in.ok) entries.clear();
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_entries = std::move(entries);
+		_checked.clear();
+		_key = key;
+		_processId = processId;
+		_processStart = processStart;
+		_lookup = _entries.size() > 0;
+		_recording = true;
+		_changed = true;
+	}
+	Save(); //Right away, so that even a run that stops early marks this process as written to
+}
+
+void PanelCatalog::Save()
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	if (!_recording || !_changed) return;
+	BinaryWriter out(FILENAME);
+	if (!out.isOpen()) return; //The catalog is only an optimization
+	out.writeBytes(MAGIC, 4);
+	out.writeInt(FORMAT_VERSION);
+	out.writeInt(_key.globals);
+	out.writeInt(static_cast<int>(_key.version.size()));
+	out.writeBytes(_key.version.data(), _key.version.size());
+	out.writeInt(static_cast<int>(_processId));
+	out.writeBytes(&_processStart, sizeof(uint64_t));
+	out.writeInt(static_cast<int>(_entries.size()));
+	for (const auto& [id, entry] : _entries) {
+		out.writeInt(id);
+		out.writeInt(entry.width);
+		out.writeInt(entry.height);
+		out.writeInt(entry.pillarWidth);
+		out.writeInt(entry.style);
+		out.writeInt(entry.symmetry);
+		out.writeBytes(&entry.minx, sizeof(float) * 6);
+		out.writeInts(entry.grid);
+		out.writeInts(entry.startpoints);
+		out.writeInts(entry.endpoints);
+		out.writeInts(entry.arraySizes);
+		out.writeBytes(&entry.header, sizeof(uint64_t));
+	}
+	_changed = false;
+}
+
+bool PanelCatalog::Load(Panel& panel)
+{
+	if (Memory::GetWriteCount(panel.id) > 0) return false;
+	uint64_t header;
+	bool checked;
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		if (!_lookup) return false;
+		auto it = _entries.find(panel.id);
+		if (it == _entries.end()) return false;
+		header = it->second.header;
+		checked = _checked.count(panel.id) > 0;
+	}
+	//First use this run: make sure the game still has the panel the entry was recorded from
+	bool valid = checked || ReadHeader(panel) == header;
+	std::lock_guard<std::mutex> lock(_mutex);
+	auto it = _entries.find(panel.id);
+	if (it == _entries.end()) return false;
+	if (!valid) {
+		_entries.erase(it); //Record puts the panel as it is now in its place
+		_changed = true;
+		return false;
+	}
+	_checked.insert(panel.id);
+	const Entry& entry = it->second;
+	panel._width = entry.width;
+	panel._height = entry.height;
+	Point::pillarWidth = entry.pillarWidth;
+	panel._style = entry.style;
+	panel.symmetry = static_cast<Panel::Symmetry>(entry.symmetry);
+	panel.minx = entry.minx; panel.miny = entry.miny;
+	panel.maxx = entry.maxx; panel.maxy = entry.maxy;
+	panel.unitWidth = entry.unitWidth; panel.unitHeight = entry.unitHeight;
+	panel._grid.assign(entry.width, std::vector<int>(entry.height));
+	for (int x = 0; x < entry.width; x++) {
+		std::copy(entry.grid.begin() + x * entry.height, entry.grid.begin() + (x + 1) * entry.height, panel._grid[x].begin());
+	}
+	panel._startpoints.clear();
+	for (size_t i = 0; i + 1 < entry.startpoints.size(); i += 2) panel._startpoints.push_back({ entry.startpoints[i], entry.startpoints[i + 1] });
+	panel._endpoints.clear();
+	for (size_t i = 0; i + 3 < entry.endpoints.size(); i += 4) {
+		panel._endpoints.emplace_back(entry.endpoints[i], entry.endpoints[i + 1], static_cast<Endpoint::Direction>(entry.endpoints[i + 2]), entry.endpoints[i + 3]);
+	}
+	for (size_t i = 0; i + 1 < entry.arraySizes.size(); i += 2) panel._memory->SetArraySize(panel.id, entry.arraySizes[i], entry.arraySizes[i + 1]);
+	return true;
+}
+
+void PanelCatalog::Record(const Panel& panel)
+{
+	if (Memory::GetWriteCount(panel.id) > 0) return;
+	Entry entry = Describe(panel);
+	std::lock_guard<std::mutex> lock(_mutex);
+	if (!_recording || _entries.count(panel.id)) return;
+	_entries[panel.id] = std::move(entry);
+	_changed = true;
+}
+
+PanelCatalog::Entry PanelCatalog::Describe(const Panel& panel)
+{
+	Entry entry;
+	entry.width = panel._width;
+	entry.height = panel._height;
+	entry.pillarWidth = Point::pillarWidth; //Set by Panel::Read
+	entry.style = panel._style;
+	entry.symmetry = panel.symmetry;
+	entry.minx = panel.minx; entry.miny = panel.miny;
+	entry.maxx = panel.maxx; entry.maxy = panel.maxy;
+	entry.unitWidth = panel.unitWidth; entry.unitHeight = panel.unitHeight;
+	for (const std::vector<int>& column : panel._grid) entry.grid.insert(entry.grid.end(), column.begin(), column.end());
+	for (const Point& p : panel._startpoints) {
+		entry.startpoints.push_back(p.first);
+		entry.startpoints.push_back(p.second);
+	}
+	for (Endpoint e : panel._endpoints) {
+		entry.endpoints.insert(entry.endpoints.end(), { e.GetX(), e.GetY(), e.GetDir(), e.GetFlags() });
+	}
+	std::vector<int> sizes = panel._memory->GetArraySizes(panel.id);
+	for (size_t i = 0; i + 1 < sizes.size(); i += 2) {
+		if (sizes[i] == TRACED_EDGE_DATA || sizes[i] == TRACED_EDGE_DATA + 8) continue; //Changes while the game runs
+		entry.arraySizes.push_back(sizes[i]);
+		entry.arraySizes.push_back(sizes[i + 1]);
+	}
+	entry.header = ReadHeader(panel);
+	return entry;
+}
+
+uint64_t PanelCatalog::ReadHeader(const Panel& panel)
+{
+	std::vector<byte> data = panel._memory->ReadPanelData<byte>(panel.id, HEADER_START, HEADER_END - HEADER_START);
+	uint64_t hash = 14695981039346656037ull; //FNV-1a over the fields
+	for (int offset : HEADER_FIELDS) {
+		for (int i = 0; i < static_cast<int>(sizeof(int)); i++) hash = (hash ^ data[offset - HEADER_START + i]) * 1099511628211ull;
+	}
+	return hash;
+}
@@ -0,0 +1,59 @@
+#pragma once
+#include <vector>
+#include <map>
+#include <set>
+#include <mutex>
+#include <string>
+#include <stdint.h>
+
+class Panel;
+
+//Decoded geometry of unmodified panels (size, pillar flag, symmetry, grid, starts and exits, bounding box), saved so Panel::Read can skip reading them from the game.
+//None of this changes for a game build, but the randomizer changes panels and they stay changed until the game restarts.
+//So the catalog is only used with a game process the randomizer hasn't written to before, and only for panels that haven't been written yet (see Memory::GetWriteCount).
+//Entries are recorded the first time such a panel is read, and saved at the end of the run. Each entry also keeps a hash of the panel's header fields (sizes, counts, style),
+//which is checked against the game the first time the entry is used in a run. An entry that doesn't match is dropped, and the panel read from the game instead.
+class PanelCatalog
+{
+public:
+	//Load the catalog for this run. version - the randomizer version, since decoding can change between versions.
+	static void Begin(const std::string& version);
+	static void Save();
+
+	//Fill in panel from the catalog. Returns false if it has to be read from the game.
+	static bool Load(Panel& panel);
+	//Add panel (just read from the game) to the catalog, if it is unmodified
+	static void Record(const Panel& panel);
+
+	static const char* FILENAME;
+
+private:
+	struct Entry {
+		int width, height, pillarWidth, style, symmetry;
+		float minx, miny, maxx, maxy, unitWidth, unitHeight;
+		std::vector<int> grid; //Column by column, like Panel::_grid
+		std::vector<int> startpoints; //x, y
+		std::vector<int> endpoints; //x, y, direction, flags
+		std::vector<int> arraySizes; //offset, size - what Memory learns about the panel's arrays while reading it
+		uint64_t header; //See ReadHeader
+	};
+
+	struct Key {
+		int globals;
+		std::string version;
+	};
+
+	static Entry Describe(const Panel& panel);
+	//Hash of the panel's scalar header fields in the game, read in one go. Array pointers in between are left out, since they differ every time the game runs.
+	static uint64_t ReadHeader(const Panel& panel);
+
+	static std::map<int, Entry> _entries;
+	static std::set<int> _checked; //Entries whose header matched the game this run
+	static Key _key;
+	static uint32_t _processId;
+	static uint64_t _processStart;
+	static bool _lookup, _recording, _changed;
+	static std::mutex _mutex;
+
+	static const int FORMAT_VERSION = 2;
+};
@@ -0,0 +1,230 @@
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+
+// PVS-Studio Static Code Analyzer for C, C++, C#, and Java: http://www.viva64.com
+
+#include "PanelSnapshot.h"
+#include "Memory.h"
+#include "BinaryFile.h"
+#include <algorithm>
+#include <cstdio>
+
+const char* PanelSnapshot::FILENAME = "WRPGsnapshot.bin";
+
+std::map<int, PanelSnapshot::Original> PanelSnapshot::_originals;
+bool PanelSnapshot::_changed = false;
+std::mutex PanelSnapshot::_mutex;
+
+namespace {
+	const char MAGIC[4] = { 'W', 'R', 'P', 'S' };
+}
+
+void PanelSnapshot::Capture(Memory& memory, const std::vector<Field>& fields)
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	//The part of each panel's struct that holds uncaptured bytes (array pointers included)
+	std::map<int, std::pair<int, int>> spans;
+	for (const Field& field : fields) {
+		int size = static_cast<int>(field.isArray ? sizeof(uintptr_t) : field.numBytes);
+		if (size == 0 || IsCaptured(_originals[field.panel], field.offset, size)) continue;
+		auto it = spans.find(field.panel);
+		if (it == spans.end()) spans[field.panel] = { field.offset, field.offset + size };
+		else it->second = { min(it->second.first, field.offset), max(it->second.second, field.offset + size) };
+	}
+	for (const auto& [panel, span] : spans) {
+		std::vector<uint8_t> data = memory.ReadData<uint8_t>({ Memory::GLOBALS, 0x18, panel * 8, span.first }, span.second - span.first);
+		Original& original = _originals[panel];
+		//Only the written bytes are kept - the ones between them may be changed by the game, and must not be put back
+		for (const Field& field : fields) {
+			if (field.panel != panel) continue;
+			int size = static_cast<int>(field.isArray ? sizeof(uintptr_t) : field.numBytes);
+			if (size == 0 || field.offset < span.first || field.offset + size > span.second) continue; //Captured before, so it wasn't read
+			if (Merge(original, field.offset, &data[field.offset - span.first], size)) _changed = true;
+		}
+	}
+	for (const Field& field : fields) {
+		if (field.isArray) captureArray(memory, field.panel, field.offset, field.numBytes, field.capacity);
+	}
+}
+
+void PanelSnapshot::CaptureField(Memory& memory, int panel, int offset, size_t numBytes)
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	captureField(memory, panel, offset, numBytes);
+}
+
+void PanelSnapshot::CaptureArray(Memory& memory, int panel, int offset, size_t numBytes, size_t capacity)
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	captureArray(memory, panel, offset, numBytes, capacity);
+}
+
+void PanelSnapshot::captureField(Memory& memory, int panel, int offset, size_t numBytes)
+{
+	Original& original = _originals[panel];
+	if (numBytes == 0 || IsCaptured(original, offset, numBytes)) return;
+	std::vector<uint8_t> data = memory.ReadData<uint8_t>({ Memory::GLOBALS, 0x18, panel * 8, offset }, numBytes);
+	if (Merge(original, offset, &data[0], numBytes)) _changed = true;
+}
+
+void PanelSnapshot::captureArray(Memory& memory, int panel, int offset, size_t numBytes, size_t capacity)
+{
+	captureField(memory, panel, offset, sizeof(uintptr_t));
+	if (numBytes == 0 || numBytes > capacity) return; //Goes to a new array, so the one the pointer points to now isn't touched
+	Original& original = _originals[panel];
+	std::vector<uint8_t> pointer = memory.ReadData<uint8_t>({ Memory::GLOBALS, 0x18, panel * 8, offset }, sizeof(uintptr_t));
+	if (!std::equal(pointer.begin(), pointer.end(), original.bytes.begin() + (offset - original.start))) return; //An array the randomizer allocated
+	std::vector<uint8_t>& contents = original.arrays[offset];
+	if (contents.size() >= numBytes) return;
+	//Anything past what was captured before hasn't been overwritten yet
+	std::vector<uint8_t> rest = memory.ReadData<uint8_t>({ Memory::GLOBALS, 0x18, panel * 8, offset, static_cast<int>(contents.size()) }, numBytes - contents.size());
+	contents.insert(contents.end(), rest.begin(), rest.end());
+	_changed = true;
+}
+
+bool PanelSnapshot::IsCaptured(const Original& original, int offset, size_t numBytes)
+{
+	if (offset < original.start || offset + numBytes > original.start + original.bytes.size()) return false;
+	for (size_t i = offset - original.start; i < offset - original.start + numBytes; i++) {
+		if (!original.captured[i]) return false;
+	}
+	return true;
+}
+
+bool PanelSnapshot::Merge(Original& original, int offset, const uint8_t* data, size_t numBytes)
+{
+	int end = offset + static_cast<int>(numBytes);
+	if (original.bytes.size() == 0) original.start = offset;
+	//Grow the buffer to cover [offset, end)
+	if (offset < original.start) {
+		original.bytes.insert(original.bytes.begin(), original.start - offset, 0);
+		original.captured.insert(original.captured.begin(), original.start - offset, false);
+		original.start = offset;
+	}
+	if (end > original.start + static_cast<int>(original.bytes.size())) {
+		original.bytes.resize(end - original.start, 0);
+		original.captured.resize(end - original.start, false);
+	}
+	bool added = false;
+	for (size_t i = 0; i < numBytes; i++) {
+		size_t index = offset - original.start + i;
+		if (original.captured[index]) continue;
+		original.bytes[index] = data[i];
+		original.captured[index] = true;
+		added = true;
+	}
+	return added;
+}
+
+int PanelSnapshot::Restore()
+{
+	Memory memory("witness64_d3d11.exe");
+	std::lock_guard<std::mutex> lock(_mutex);
+	for (const auto& [panel, original] : _originals) {
+		//The struct goes first, which also puts the original array pointers back
+		for (size_t i = 0; i < original.bytes.size();) {
+			if (!original.captured[i]) {
+				i++;
+				continue;
+			}
+			size_t end = i;
+			while (end < original.bytes.size() && original.captured[end]) end++;
+			memory.WriteData<uint8_t>({ Memory::GLOBALS, 0x18, panel * 8, original.start + static_cast<int>(i) },
+				std::vector<uint8_t>(original.bytes.begin() + i, original.bytes.begin() + end));
+			i = end;
+		}
+		for (const auto& [offset, contents] : original.arrays) {
+			if (contents.size() > 0) memory.WriteData<uint8_t>({ Memory::GLOBALS, 0x18, panel * 8, offset, 0 }, contents);
+		}
+		Memory::CountWrite(panel); //So nothing read from the randomized panel is used again
+	}
+	return static_cast<int>(_originals.size());
+}
+
+bool PanelSnapshot::Empty()
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	return _originals.size() == 0;
+}
+
+bool PanelSnapshot::Load()
+{
+	Memory memory("witness64_d3d11.exe");
+	BinaryReader in(FILENAME);
+	if (!in.readMagic(MAGIC) || in.readInt() != FORMAT_VERSION) return false;
+	uint32_t processId = static_cast<uint32_t>(in.readInt());
+	uint64_t processStart = 0;
+	in.readBytes(&processStart, sizeof(uint64_t));
+	int globals = in.readInt();
+	if (!in.ok || processId != memory.GetProcessId() || processStart != memory.GetProcessStartTime() || globals != Memory::GLOBALS) return false;
+
+	std::map<int, Original> originals;
+	int numPanels = in.readCount(3 * sizeof(int));
+	for (int i = 0; i < numPanels && in.ok; i++) {
+		Original& original = originals[in.readInt()];
+		//Runs of captured bytes, then arrays, each as offset, size, bytes
+		int numRuns = in.readCount(2 * sizeof(int));
+		for (int j = 0; j < numRuns && in.ok; j++) {
+			int offset = in.readInt();
+			std::vector<uint8_t> data(in.readCount(1));
+			if (data.size() > 0) {
+				in.readBytes(&data[0], data.size());
+				Merge(original, offset, &data[0], data.size());
+			}
+		}
+		int numArrays = in.readCount(2 * sizeof(int));
+		for (int j = 0; j < numArrays && in.ok; j++) {
+			std::vector<uint8_t>& contents = original.arrays[in.readInt()];
+			contents.resize(in.readCount(1));
+			if (contents.size() > 0) in.readBytes(&contents[0], contents.size());
+		}
+	}
+	if (!in.ok) return false;
+	std::lock_guard<std::mutex> lock(_mutex);
+	_originals = std::move(originals);
+	_changed = false;
+	return true;
+}
+
+void PanelSnapshot::Save()
+{
+	Memory memory("witness64_d3d11.exe");
+	std::lock_guard<std::mutex> lock(_mutex);
+	if (!_changed) return;
+	//Written to a temporary file first, so a crash halfway through can't leave a snapshot that loads wrong
+	std::string temp = std::string(FILENAME) + ".tmp";
+	{
+		BinaryWriter out(temp.c_str());
+		if (!out.isOpen()) return;
+		out.writeBytes(MAGIC, 4);
+		out.writeInt(FORMAT_VERSION);
+		out.writeInt(static_cast<int>(memory.GetProcessId()));
+		uint64_t processStart = memory.GetProcessStartTime();
+		out.writeBytes(&processStart, sizeof(uint64_t));
+		out.writeInt(Memory::GLOBALS);
+		out.writeInt(static_cast<int>(_originals.size()));
+		for (const auto& [panel, original] : _originals) {
+			out.writeInt(panel);
+			std::vector<std::pair<size_t, size_t>> runs;
+			for (size_t i = 0; i < original.bytes.size(); i++) {
+				if (!original.captured[i]) continue;
+				if (runs.size() > 0 && runs.back().second == i) runs.back().second++;
+				else runs.push_back({ i, i + 1 });
+			}
+			out.writeInt(static_cast<int>(runs.size()));
+			for (const auto& [begin, end] : runs) {
+				out.writeInt(original.start + static_cast<int>(begin));
+				out.writeInt(static_cast<int>(end - begin));
+				out.writeBytes(&original.bytes[begin], end - begin);
+			}
+			out.writeInt(static_cast<int>(original.arrays.size()));
+			for (const auto& [offset, contents] : original.arrays) {
+				out.writeInt(offset);
+				out.writeInt(static_cast<int>(contents.size()));
+				out.writeBytes(contents.data(), contents.size());
+			}
+		}
+	}
+	std::remove(FILENAME);
+	std::rename(temp.c_str(), FILENAME);
+	_changed = false;
+}
@@ -0,0 +1,57 @@
+#pragma once
+#include <vector>
+#include <map>
+#include <mutex>
+#include <stdint.h>
+
+class Memory;
+
+//The game's original panel data, captured right before the randomizer first overwrites it, so every panel can be put back without restarting the game.
+//Memory calls the Capture functions before anything reaches the game. Only the first capture of each byte is kept, so later writes never replace an original.
+//Array contents are only kept for arrays that were overwritten in place. Arrays the randomizer allocated itself are dropped on restore by putting the old pointer back.
+//Originals are saved to disk, for the game process they came from, so a randomizer that is closed and reopened can still restore.
+class PanelSnapshot
+{
+public:
+	struct Field {
+		int panel, offset;
+		size_t numBytes;
+		bool isArray;
+		size_t capacity; //Arrays only: size in bytes of the array already in the game. The array is reallocated instead of overwritten if numBytes is larger.
+	};
+
+	//Capture the originals of a batch of writes, with one read of each panel's struct instead of one per write
+	static void Capture(Memory& memory, const std::vector<Field>& fields);
+	static void CaptureField(Memory& memory, int panel, int offset, size_t numBytes);
+	static void CaptureArray(Memory& memory, int panel, int offset, size_t numBytes, size_t capacity);
+
+	//Write back every original, one write per run of captured bytes, then one per array. Returns the number of panels restored.
+	static int Restore();
+	static bool Empty();
+
+	//Originals are only loaded for the game process they were captured from
+	static bool Load();
+	static void Save();
+
+	static const char* FILENAME;
+
+private:
+	struct Original {
+		int start = 0; //Offset of bytes[0] in the panel's struct
+		std::vector<uint8_t> bytes;
+		std::vector<bool> captured;
+		std::map<int, std::vector<uint8_t>> arrays; //Original contents of arrays that were overwritten in place, by offset
+	};
+
+	static bool IsCaptured(const Original& original, int offset, size_t numBytes);
+	static bool Merge(Original& original, int offset, const uint8_t* data, size_t numBytes); //Keeps bytes that were already captured. Returns true if any byte was new.
+	//Same as the public versions, with _mutex already held
+	static void captureField(Memory& memory, int panel, int offset, size_t numBytes);
+	static void captureArray(Memory& memory, int panel, int offset, size_t numBytes, size_t capacity);
+
+	static std::map<int, Original> _originals;
+	static bool _changed;
+	static std::mutex _mutex;
+
+	static const int FORMAT_VERSION = 1;
+};
@@ -0,0 +1,104 @@
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+
+// PVS-Studio Static Code Analyzer for C, C++, C#, and Java: http://www.viva64.com
+
+#include "PanelStats.h"
+#include "Generate.h"
+#include "BinaryFile.h"
+
+std::atomic<bool> PanelStats::_enabled = false;
+std::atomic<int> PanelStats::_seed = 0;
+std::vector<PanelStats::Row> PanelStats::_rows;
+std::vector<PanelStats::Relaxed> PanelStats::_relaxations;
+std::mutex PanelStats::_mutex;
+thread_local std::chrono::steady_clock::time_point PanelStats::_start = std::chrono::steady_clock::now();
+thread_local int PanelStats::_attemptsAtStart = 0;
+thread_local uint32_t PanelStats::_retryDepth = 0;
+thread_local uint32_t PanelStats::_relaxation = 0;
+
+namespace {
+	const char MAGIC[4] = { 'W', 'R', 'P', 'T' };
+}
+
+void PanelStats::enable(int seed)
+{
+	_seed = seed;
+	_enabled = true;
+	beginTask();
+}
+
+void PanelStats::beginTask()
+{
+	_start = std::chrono::steady_clock::now();
+	_attemptsAtStart = Generate::attempts;
+	_retryDepth = 0;
+	_relaxation = 0;
+}
+
+void PanelStats::noteRetries(int retries)
+{
+	_retryDepth = max(_retryDepth, static_cast<uint32_t>(retries));
+}
+
+void PanelStats::record(int panel)
+{
+	if (!_enabled) return;
+	std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+	Row row = { _seed, panel, std::chrono::duration<float, std::milli>(now - _start).count(), static_cast<uint32_t>(Generate::attempts - _attemptsAtStart), _retryDepth, _relaxation };
+	beginTask();
+	std::lock_guard<std::mutex> lock(_mutex);
+	_rows.push_back(row);
+}
+
+void PanelStats::recordRelaxation(int panel, int step)
+{
+	_relaxation = static_cast<uint32_t>(step);
+	std::lock_guard<std::mutex> lock(_mutex);
+	_relaxations.push_back({ panel, step });
+}
+
+std::vector<PanelStats::Relaxed> PanelStats::relaxations()
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	return _relaxations;
+}
+
+std::vector<PanelStats::Row> PanelStats::take()
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	std::vector<Row> rows;
+	rows.swap(_rows);
+	return rows;
+}
+
+bool PanelStats::writeColumns(const std::string& file, const std::vector<Row>& rows)
+{
+	BinaryWriter out(file.c_str());
+	if (!out.isOpen()) return false;
+	out.writeBytes(MAGIC, 4);
+	out.writeInt(FORMAT_VERSION);
+	out.writeInt(static_cast<int>(rows.size()));
+	for (const Row& row : rows) out.writeInt(row.seed);
+	for (const Row& row : rows) out.writeInt(row.panel);
+	for (const Row& row : rows) out.writeBytes(&row.millis, sizeof(float));
+	for (const Row& row : rows) out.writeInt(static_cast<int>(row.attempts));
+	for (const Row& row : rows) out.writeInt(static_cast<int>(row.retryDepth));
+	for (const Row& row : rows) out.writeInt(static_cast<int>(row.relaxation));
+	return true;
+}
+
+bool PanelStats::readColumns(const std::string& file, std::vector<Row>& rows)
+{
+	BinaryReader in(file.c_str());
+	if (!in.readMagic(MAGIC) || in.readInt() != FORMAT_VERSION) return false;
+	std::vector<Row> result(in.readCount(6 * sizeof(int)));
+	for (Row& row : result) row.seed = in.readInt();
+	for (Row& row : result) row.panel = in.readInt();
+	for (Row& row : result) in.readBytes(&row.millis, sizeof(float));
+	for (Row& row : result) row.attempts = static_cast<uint32_t>(in.readInt());
+	for (Row& row : result) row.retryDepth = static_cast<uint32_t>(in.readInt());
+	for (Row& row : result) row.relaxation = static_cast<uint32_t>(in.readInt());
+	if (!in.ok) return false;
+	rows.insert(rows.end(), result.begin(), result.end());
+	return true;
+}
@@ -0,0 +1,54 @@
+#pragma once
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <atomic>
+#include <stdint.h>
+
+//Wall time, attempts and stage retries of every panel Generate writes, for finding the (seed, panel) pairs that take far longer than the rest (see the Sweep project).
+//Each generator thread measures from the end of its last panel, or from beginTask, to the end of the next one, so setup between panels counts towards the panel after it.
+class PanelStats
+{
+public:
+	struct Row {
+		int seed, panel;
+		float millis;
+		uint32_t attempts; //See Generate::attempts
+		uint32_t retryDepth; //Most times a single placement stage was retried in one attempt
+		uint32_t relaxation; //Last Generate::Relaxation step the panel needed, or 0 if its recipe was made as asked
+	};
+
+	struct Relaxed {
+		int panel;
+		int step; //Generate::Relaxation
+	};
+
+	//Start collecting. Rows are tagged with seed until the next call.
+	static void enable(int seed);
+	static bool enabled() { return _enabled; }
+	static void beginTask(); //Restart this thread's measurement, e.g. when a worker thread picks up a new area
+	static void noteRetries(int retries);
+	static void record(int panel);
+	//Relaxations are kept even when stats are off, since they change which puzzles a seed makes
+	static void recordRelaxation(int panel, int step);
+	static std::vector<Relaxed> relaxations(); //Every relaxation since the program started, in the order they happened
+	static std::vector<Row> take(); //Everything recorded so far. Clears the list.
+
+	//The rows are stored a column at a time, so each column can be read or compressed on its own
+	static bool writeColumns(const std::string& file, const std::vector<Row>& rows);
+	static bool readColumns(const std::string& file, std::vector<Row>& rows);
+
+private:
+	static std::atomic<bool> _enabled;
+	static std::atomic<int> _seed;
+	static std::vector<Row> _rows;
+	static std::vector<Relaxed> _relaxations;
+	static std::mutex _mutex;
+	static thread_local std::chrono::steady_clock::time_point _start;
+	static thread_local int _attemptsAtStart;
+	static thread_local uint32_t _retryDepth;
+	static thread_local uint32_t _relaxation;
+
+	static const int FORMAT_VERSION = 2;
+};
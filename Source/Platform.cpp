@@ -0,0 +1,27 @@
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+
+// PVS-Studio Static Code Analyzer for C, C++, C#, and Java: http://www.viva64.com
+
+#include "Platform.h"
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <iostream>
+#endif
+
+void SetStatusText(WindowHandle window, const std::wstring& text)
+{
+	if (!window) return;
+#ifdef _WIN32
+	SetWindowText(static_cast<HWND>(window), text.c_str());
+#endif
+}
+
+void ShowMessage(const std::wstring& text, const std::wstring& title)
+{
+#ifdef _WIN32
+	MessageBox(GetActiveWindow(), text.c_str(), title.size() > 0 ? title.c_str() : NULL, MB_OK);
+#else
+	std::wcerr << text << std::endl;
+#endif
+}
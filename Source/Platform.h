@@ -0,0 +1,15 @@
+#pragma once
+#include <string>
+#include <algorithm>
+
+//The few things the randomizer needs from the operating system besides the game process (see MemoryProcess.cpp).
+//Only the platform files include windows.h, so the generator builds anywhere and can run against a MemoryImage without the game.
+typedef void* WindowHandle; //An HWND on Windows
+typedef unsigned char byte;
+using std::min;
+using std::max;
+
+//Set the title of the loading window. Does nothing if there is no window.
+void SetStatusText(WindowHandle window, const std::wstring& text);
+//Show a message box over the active window on Windows. Written to stderr anywhere else.
+void ShowMessage(const std::wstring& text, const std::wstring& title = L"");
@@ -4,79 +4,186 @@
 
 #include "PuzzleList.h"
 #include "Watchdog.h"
+#include "PanelCache.h"
+#include "StageStats.h"
+#include "PanelCatalog.h"
+#include "PanelStats.h"
 
 void PuzzleList::GenerateAllN()
 {
+	Random::seedPanels(baseSeed, Random::Difficulty::Normal);
 	generator->setLoadingData(336);
-	CopyTargets();
-	GenerateTutorialN();
-	GenerateSymmetryN();
-	GenerateQuarryN();
-	//GenerateBunkerN(); //Can't randomize because panels refuse to render the symbols
-	GenerateSwampN();
-	GenerateTreehouseN();
-	GenerateTownN();
-	GenerateVaultsN();
-	GenerateTrianglePanelsN();
-	GenerateOrchardN();
-	GenerateDesertN();
-	GenerateKeepN();
-	GenerateJungleN();
-	GenerateMountainN();
-	GenerateCavesN(); 
-	SetWindowText(_handle, L"Done!");
+	GenerateAreas(Random::Difficulty::Normal, {
+		{ L"Tutorial", &PuzzleList::GenerateTutorialN },
+		{ L"Symmetry", &PuzzleList::GenerateSymmetryN },
+		{ L"Quarry", &PuzzleList::GenerateQuarryN },
+		//{ L"Bunker", &PuzzleList::GenerateBunkerN }, //Can't randomize because panels refuse to render the symbols
+		{ L"Swamp", &PuzzleList::GenerateSwampN },
+		{ L"Treehouse", &PuzzleList::GenerateTreehouseN },
+		{ L"Town", &PuzzleList::GenerateTownN },
+		{ L"Vaults", &PuzzleList::GenerateVaultsN },
+		{ L"Triangles", &PuzzleList::GenerateTrianglePanelsN },
+		{ L"Orchard", &PuzzleList::GenerateOrchardN },
+		{ L"Desert", &PuzzleList::GenerateDesertN },
+		{ L"Keep", &PuzzleList::GenerateKeepN },
+		{ L"Jungle", &PuzzleList::GenerateJungleN },
+		{ L"Mountain", &PuzzleList::GenerateMountainN },
+		{ L"Caves", &PuzzleList::GenerateCavesN },
+		//{ L"Shadows", &PuzzleList::GenerateShadowsN }, //Can't randomize
+		//{ L"Monastery", &PuzzleList::GenerateMonasteryN }, //Can't randomize
+	});
+	SetStatusText(_handle, L"Done!");
 	(new ArrowWatchdog(0x0056E))->start(); //Easy way to close the randomizer when the game is done
-	//GenerateShadowsN(); //Can't randomize
-	//GenerateMonasteryN(); //Can't randomize
 }
 
 void PuzzleList::GenerateAllH()
 {
+	Random::seedPanels(baseSeed, Random::Difficulty::Expert);
 	generator->setLoadingData(349);
-	CopyTargets();
-	GenerateTutorialH();
-	GenerateSymmetryH();
-	GenerateQuarryH();
-	//GenerateBunkerH(); //Can't randomize because panels refuse to render the symbols
-	GenerateSwampH();
-	GenerateTreehouseH();
-	GenerateTownH();
-	GenerateVaultsH();
-	GenerateTrianglePanelsH();
-	GenerateOrchardH();
-	GenerateDesertH();
-	GenerateKeepH();
-	GenerateJungleH();
-	GenerateMountainH();
-	GenerateCavesH();
-	SetWindowText(_handle, L"Done!");
-	//GenerateShadowsH(); //Can't randomize
-	//GenerateMonasteryH(); //Can't randomize
+	GenerateAreas(Random::Difficulty::Expert, {
+		{ L"Tutorial", &PuzzleList::GenerateTutorialH },
+		{ L"Symmetry", &PuzzleList::GenerateSymmetryH },
+		{ L"Quarry", &PuzzleList::GenerateQuarryH },
+		//{ L"Bunker", &PuzzleList::GenerateBunkerH }, //Can't randomize because panels refuse to render the symbols
+		{ L"Swamp", &PuzzleList::GenerateSwampH },
+		{ L"Treehouse", &PuzzleList::GenerateTreehouseH },
+		{ L"Town", &PuzzleList::GenerateTownH },
+		{ L"Vaults", &PuzzleList::GenerateVaultsH },
+		{ L"Arrows", &PuzzleList::GenerateTrianglePanelsH },
+		{ L"Orchard", &PuzzleList::GenerateOrchardH },
+		{ L"Desert", &PuzzleList::GenerateDesertH },
+		{ L"Keep", &PuzzleList::GenerateKeepH },
+		{ L"Jungle", &PuzzleList::GenerateJungleH },
+		{ L"Mountain", &PuzzleList::GenerateMountainH },
+		{ L"Caves", &PuzzleList::GenerateCavesH },
+		//{ L"Shadows", &PuzzleList::GenerateShadowsH }, //Can't randomize
+		//{ L"Monastery", &PuzzleList::GenerateMonasteryH }, //Can't randomize
+	});
+	SetStatusText(_handle, L"Done!");
 }
 
 void PuzzleList::GenerateAllE()
 {
+	Random::seedPanels(baseSeed, Random::Difficulty::Easy);
 	generator->setLoadingData(336);
-	CopyTargets();
- 	GenerateTutorialE();
-	GenerateSymmetryE(); // */
-	GenerateQuarryE();
-	//GenerateBunkerE(); //Can't randomize because panels refuse to render the symbols
-/*	GenerateSwampE();
-	GenerateTreehouseE();
-	GenerateTownE();
-	GenerateVaultsE();
-	GenerateTrianglePanelsE();
-	GenerateOrchardE();
-	GenerateDesertE();
-	GenerateKeepE();
-	GenerateJungleE();
-	GenerateMountainE();
-	GenerateCavesE(); // */
-	SetWindowText(_handle, L"Done!");
+	GenerateAreas(Random::Difficulty::Easy, {
+		{ L"Tutorial", &PuzzleList::GenerateTutorialE },
+		{ L"Symmetry", &PuzzleList::GenerateSymmetryE },
+		{ L"Quarry", &PuzzleList::GenerateQuarryE },
+		//{ L"Bunker", &PuzzleList::GenerateBunkerE }, //Can't randomize because panels refuse to render the symbols
+/*		{ L"Swamp", &PuzzleList::GenerateSwampE },
+		{ L"Treehouse", &PuzzleList::GenerateTreehouseE },
+		{ L"Town", &PuzzleList::GenerateTownE },
+		{ L"Vaults", &PuzzleList::GenerateVaultsE },
+		{ L"Triangles", &PuzzleList::GenerateTrianglePanelsE },
+		{ L"Orchard", &PuzzleList::GenerateOrchardE },
+		{ L"Desert", &PuzzleList::GenerateDesertE },
+		{ L"Keep", &PuzzleList::GenerateKeepE },
+		{ L"Jungle", &PuzzleList::GenerateJungleE },
+		{ L"Mountain", &PuzzleList::GenerateMountainE },
+		{ L"Caves", &PuzzleList::GenerateCavesE }, // */
+		//{ L"Shadows", &PuzzleList::GenerateShadowsE }, //Can't randomize
+		//{ L"Monastery", &PuzzleList::GenerateMonasteryE }, //Can't randomize
+	});
+	SetStatusText(_handle, L"Done!");
 	(new ArrowWatchdog(0x0056E))->start(); //Easy way to close the randomizer when the game is done
-	//GenerateShadowsE(); //Can't randomize
-	//GenerateMonasteryE(); //Can't randomize
+}
+
+//Run each area as its own task, after CopyTargets. No two areas write the same panel, so they can run in any order.
+//Each task gets its own Generate/Special and reseeds from its area name first, so the result is the same for any number of threads.
+//The panels each task generates are kept apart and added to Panel's lists in area order once every task is done, so those lists come out the same too.
+//Unless the write mode is Direct, writes go through the staging image and are all in the game by the time this returns.
+void PuzzleList::GenerateAreas(Random::Difficulty difficulty, const std::vector<std::pair<std::wstring, AreaFunc>>& areas)
+{
+	PanelCache::Key key = { baseSeed, difficulty, colorblind, cacheDoubleMode, !Special::hasBeenRandomized(), Memory::GLOBALS, cacheVersion };
+	PanelCache::Entry cached;
+	if (useCache && PanelCache::Load(key, cached)) {
+		SetStatusText(_handle, L"Loading from cache...");
+		Memory::ApplyWrites(cached.writes);
+		{
+			std::lock_guard<std::mutex> lock(Panel::generatedMutex);
+			Panel::arrowPuzzles.insert(Panel::arrowPuzzles.end(), cached.arrowPuzzles.begin(), cached.arrowPuzzles.end());
+		}
+		for (const std::vector<int>& record : cached.watchdogs) {
+			Watchdog* watchdog = Watchdog::fromRecord(record);
+			if (watchdog) watchdog->start();
+		}
+		Random::beginArea();
+		Random::seedArea(L"Done");
+		return;
+	}
+
+	Panel::ClearTemplates();
+	PanelCatalog::Begin(cacheVersion);
+	std::shared_ptr<std::atomic<int>> progress = std::make_shared<std::atomic<int>>(0);
+	TaskGraph tasks;
+	int copyTargets = tasks.addTask([this]() { CopyTargets(); });
+	std::vector<std::shared_ptr<Panel::Generated>> generated;
+	for (const auto& [areaName, area] : areas) {
+		std::shared_ptr<PuzzleList> worker = makeWorker(progress);
+		std::shared_ptr<Panel::Generated> results = std::make_shared<Panel::Generated>();
+		generated.push_back(results);
+		std::wstring name = areaName;
+		AreaFunc func = area;
+		tasks.addTask([worker, results, name, func]() {
+			Random::beginArea();
+			Random::seedArea(L"Task " + name); //Some areas use Random before their first setLoadingData
+			PanelStats::beginTask();
+			Panel::areaGenerated = results.get();
+			func(worker.get());
+			Panel::areaGenerated = nullptr;
+		}, { copyTargets });
+	}
+	int numThreads = threads > 0 ? threads : static_cast<int>(std::thread::hardware_concurrency());
+	size_t arrowsBefore = Panel::arrowPuzzles.size();
+	if (writeMode != WriteMode::Direct) Memory::BeginStaging(writeMode == WriteMode::Streamed);
+	Watchdog::startRecording();
+	try {
+		tasks.run(numThreads, [this, progress]() { generator->showProgress(*progress); });
+	}
+	catch (...) {
+		Watchdog::stopRecording();
+		if (writeMode != WriteMode::Direct) Memory::DiscardStaging(); //Drop whatever hasn't reached the game yet
+		throw;
+	}
+	generator->showProgress(*progress);
+	PanelCache::Entry entry;
+	entry.watchdogs = Watchdog::stopRecording();
+	{
+		std::lock_guard<std::mutex> lock(Panel::generatedMutex);
+		for (const std::shared_ptr<Panel::Generated>& results : generated) {
+			Panel::generatedPanels.insert(Panel::generatedPanels.end(), results->panels.begin(), results->panels.end());
+			Panel::arrowPuzzles.insert(Panel::arrowPuzzles.end(), results->arrowPuzzles.begin(), results->arrowPuzzles.end());
+			entry.watchdogs.insert(entry.watchdogs.end(), results->watchdogs.begin(), results->watchdogs.end());
+		}
+	}
+	StageStats::writeReport();
+	PanelCatalog::Save();
+	if (writeMode != WriteMode::Direct) { //Everything has to be in the game before any watchdogs start
+		if (useCache) entry.writes = Memory::GetStagedWrites();
+		SetStatusText(_handle, L"Writing puzzles...");
+		Memory::CommitStaging();
+		if (useCache) { //Direct writes aren't captured, so there is nothing to cache in that mode
+			entry.arrowPuzzles.assign(Panel::arrowPuzzles.begin() + arrowsBefore, Panel::arrowPuzzles.end());
+			PanelCache::Save(key, entry);
+		}
+	}
+	Random::beginArea();
+	Random::seedArea(L"Done"); //Whatever runs after this (panel shuffling) shouldn't depend on which thread finished last
+}
+
+std::shared_ptr<PuzzleList> PuzzleList::makeWorker(std::shared_ptr<std::atomic<int>> progress)
+{
+	std::shared_ptr<Generate> gen = std::make_shared<Generate>();
+	gen->_seed = generator->_seed;
+	gen->colorblind = colorblind;
+	gen->setProgressCounter(progress);
+	std::shared_ptr<PuzzleList> worker = std::make_shared<PuzzleList>(gen);
+	worker->seed = seed;
+	worker->baseSeed = baseSeed;
+	worker->seedIsRNG = seedIsRNG;
+	worker->colorblind = colorblind;
+	return worker;
 }
 
 void PuzzleList::CopyTargets()
@@ -689,7 +796,7 @@ void PuzzleList::GenerateTrianglePanelsN()
 void PuzzleList::GenerateMountainN()
 {
 	std::wstring text = L"Mountain Perspective";
-	SetWindowText(_handle, text.c_str());
+	SetStatusText(_handle, text);
 	specialCase->generateMountaintop(0x17C34, { { Decoration::Stone | Decoration::Color::Black, 2 },{ Decoration::Stone | Decoration::Color::White, 1, },
 		{ Decoration::Star | Decoration::Color::Black, 1, },{ Decoration::Star | Decoration::Color::White, 1 } });
 	
@@ -1893,7 +2000,7 @@ void PuzzleList::GenerateTrianglePanelsH()
 void PuzzleList::GenerateMountainH()
 {
 	std::wstring text = L"Mountain Perspective";
-	SetWindowText(_handle, text.c_str());
+	SetStatusText(_handle, text);
 	specialCase->generateMountaintop(0x17C34, {
 		{ Decoration::Triangle | Decoration::Color::White, 2 },{ Decoration::Triangle | Decoration::Color::Black, 1 },
 		{ Decoration::Star | Decoration::Color::White, 1 },{ Decoration::Star | Decoration::Color::Black, 1 },
@@ -2996,7 +3103,7 @@ void PuzzleList::GenerateTrianglePanelsE()
 void PuzzleList::GenerateMountainE()
 {
 	std::wstring text = L"Mountain Perspective";
-	SetWindowText(_handle, text.c_str());
+	SetStatusText(_handle, text);
 	specialCase->generateMountaintop(0x17C34, { { Decoration::Stone | Decoration::Color::Black, 2 },{ Decoration::Stone | Decoration::Color::White, 1, },
 		{ Decoration::Star | Decoration::Color::Black, 1, },{ Decoration::Star | Decoration::Color::White, 1 } });
 
@@ -2,6 +2,9 @@
 #include "Generate.h"
 #include "Special.h"
 #include "Random.h"
+#include "TaskGraph.h"
+#include <atomic>
+#include <functional>
 
 class PuzzleList {
 
@@ -21,7 +24,7 @@ public:
 		this->specialCase = std::make_shared<Special>(generator);
 	}
 
-	void setLoadingHandle(HWND handle) {
+	void setLoadingHandle(WindowHandle handle) {
 		_handle = handle;
 		generator->setLoadingHandle(handle);
 	}
@@ -30,11 +33,28 @@ public:
 		this->seed = seed;
 		this->seedIsRNG = isRNG;
 		this->colorblind = colorblind;
-		if (seed >= 0) generator->seed(seed);
-		else generator->seed(Random::rand());
+		baseSeed = (seed >= 0 ? seed : Random::rand());
+		generator->seed(baseSeed);
 		generator->colorblind = colorblind;
 	}
 
+	//Number of threads used to generate areas. 0 - one per core, 1 - one area at a time
+	void setThreads(int numThreads) { threads = numThreads; }
+
+	enum WriteMode {
+		Direct, //Write each panel to the game as soon as it is generated
+		Staged, //Generate everything into a staging image first and write it to the game at the end
+		Streamed, //Stage, but have a writer thread send writes to the game while generation goes on
+	};
+	void setWriteMode(WriteMode mode) { writeMode = mode; }
+
+	//Save each randomization to the cache file, and replay it instead of generating when the seed and settings match
+	void setCache(const std::string& version, bool doubleMode) {
+		useCache = true;
+		cacheVersion = version;
+		cacheDoubleMode = doubleMode;
+	}
+
 	void CopyTargets();
 
 	//--------------------------Normal difficulty---------------------------
@@ -104,10 +124,22 @@ public:
 	void GenerateJungleE();
 
 private:
+	friend class PuzzleListTests;
+
+	typedef std::function<void(PuzzleList*)> AreaFunc; //Usually one of the GenerateXxx member functions above
+	void GenerateAreas(Random::Difficulty difficulty, const std::vector<std::pair<std::wstring, AreaFunc>>& areas);
+	std::shared_ptr<PuzzleList> makeWorker(std::shared_ptr<std::atomic<int>> progress);
+
 	std::shared_ptr<Generate> generator;
 	std::shared_ptr<Special> specialCase;
-	HWND _handle = nullptr;
+	WindowHandle _handle = nullptr;
 	int seed = 0;
+	int baseSeed = 0;
+	int threads = 0;
+	WriteMode writeMode = WriteMode::Staged;
+	bool useCache = false;
+	bool cacheDoubleMode = false;
+	std::string cacheVersion;
 	bool seedIsRNG = false;
 	bool colorblind = false;
 
@@ -1,39 +1,94 @@
 #pragma once
 #include <vector>
-#include <map>
+#include <array>
+#include <utility>
+#include <exception>
 #include "Panel.h"
 #include "Random.h"
 
+//The (symbol, amount) pairs of one symbol class, stored inline so that copying a PuzzleSymbols never allocates
+struct SymbolList {
+	static const int MAX_VARIANTS = 8;
+
+	std::pair<int, int>* begin() { return &_items[0]; }
+	std::pair<int, int>* end() { return &_items[0] + _count; }
+	const std::pair<int, int>* begin() const { return &_items[0]; }
+	const std::pair<int, int>* end() const { return &_items[0] + _count; }
+	size_t size() const { return _count; }
+	std::pair<int, int>& operator[](size_t index) { return _items[index]; }
+	const std::pair<int, int>& operator[](size_t index) const { return _items[index]; }
+	void push_back(const std::pair<int, int>& item) {
+		if (_count == MAX_VARIANTS) throw std::runtime_error("Too many variants of one symbol type");
+		_items[_count++] = item;
+	}
+
+private:
+	std::array<std::pair<int, int>, MAX_VARIANTS> _items;
+	int _count = 0;
+};
+
 struct PuzzleSymbols {
-	std::map<int, std::vector<std::pair<int, int>>> symbols;
-	std::vector<std::pair<int, int>>& operator[](int symbolType) { return symbols[symbolType]; }
+	enum SymbolClass { STONES, STARS, POLYS, ERASERS, TRIANGLES, ARROWS, DOTS, GAPS, STARTS, EXITS, OTHER, NUM_CLASSES };
+
+	static int classOf(int symbolType) {
+		if (symbolType == Decoration::Gap) return GAPS;
+		if (symbolType == Decoration::Start) return STARTS;
+		if (symbolType == Decoration::Exit) return EXITS;
+		if (symbolType & Decoration::Dot) return DOTS;
+		switch (symbolType & 0x700) {
+		case Decoration::Stone: return STONES;
+		case Decoration::Star: return STARS;
+		case Decoration::Poly: return POLYS;
+		case Decoration::Eraser: return ERASERS;
+		case Decoration::Triangle: return TRIANGLES;
+		case Decoration::Arrow: return ARROWS;
+		default: return OTHER;
+		}
+	}
+
+	//Amounts may be changed through the returned list
+	SymbolList& operator[](int symbolType) {
+		_weightsValid = false;
+		return _symbols[classOf(symbolType)];
+	}
+	const SymbolList& operator[](int symbolType) const { return _symbols[classOf(symbolType)]; }
 	int style;
-	int getNum(int symbolType) {
+	int getNum(int symbolType) const {
 		int total = 0;
-		for (auto& pair : symbols[symbolType]) total += pair.second;
+		for (auto& pair : _symbols[classOf(symbolType)]) total += pair.second;
 		return total;
 	}
-	bool any(int symbolType) { return symbols[symbolType].size() > 0; }
+	bool any(int symbolType) const { return _symbols[classOf(symbolType)].size() > 0; }
+
+	//Take one symbol to be erased. Every class that has symbols is equally likely, then every variant within it, skipping empty variants and those with 25 or more.
 	int popRandomSymbol() {
-		std::vector<int> types;
-		for (auto& pair : symbols)
-			if (pair.second.size() > 0 && pair.first != Decoration::Start && pair.first != Decoration::Exit && pair.first != Decoration::Gap && pair.first != Decoration::Eraser)
-				types.push_back(pair.first);
-		int randType = types[Random::rand() % types.size()];
-		int randIndex = Random::rand() % symbols[randType].size();
-		while (symbols[randType][randIndex].second == 0 || symbols[randType][randIndex].second >= 25) {
-			randType = types[Random::rand() % types.size()];
-			randIndex = Random::rand() % symbols[randType].size();
-		}
-		symbols[randType][randIndex].second--;
-		return symbols[randType][randIndex].first;
-	}
-	PuzzleSymbols(std::vector<std::pair<int, int>> symbolVec) {
-		for (std::pair<int, int> s : symbolVec) {
-			if (s.first == Decoration::Gap || s.first == Decoration::Start || s.first == Decoration::Exit) symbols[s.first].push_back(s);
-			else if (s.first & Decoration::Dot) symbols[Decoration::Dot].push_back(s);
-			else symbols[s.first & 0x700].push_back(s);
+		if (!_weightsValid) buildWeights();
+		if (_totalWeight == 0) throw std::runtime_error("No symbols left to erase");
+		int slot = findSlot(Random::rand() % _totalWeight);
+		std::pair<int, int>& symbol = _symbols[slot / SymbolList::MAX_VARIANTS][slot % SymbolList::MAX_VARIANTS];
+		int weight = weightOf(slot);
+		symbol.second--;
+		addWeight(slot, weightOf(slot) - weight);
+		return symbol.first;
+	}
+
+	//Take one symbol away from the variant with the most, for a recipe that keeps failing. Starts, exits and amounts of 25 or more are left alone. Returns false if there was nothing to take.
+	bool removeOne() {
+		std::pair<int, int>* most = nullptr;
+		for (int symbolClass = 0; symbolClass < NUM_CLASSES; symbolClass++) {
+			if (symbolClass == STARTS || symbolClass == EXITS) continue;
+			for (std::pair<int, int>& symbol : _symbols[symbolClass]) {
+				if (symbol.second > 0 && symbol.second < 25 && (!most || symbol.second > most->second)) most = &symbol;
+			}
 		}
+		if (!most) return false;
+		most->second--;
+		_weightsValid = false;
+		return true;
+	}
+
+	PuzzleSymbols(const std::vector<std::pair<int, int>>& symbolVec) {
+		for (const std::pair<int, int>& s : symbolVec) _symbols[classOf(s.first)].push_back(s);
 		style = 0;
 		if (any(Decoration::Dot)) style |= Panel::Style::HAS_DOTS;
 		if (any(Decoration::Stone)) style |= Panel::Style::HAS_STONES;
@@ -42,5 +97,51 @@ struct PuzzleSymbols {
 		if (any(Decoration::Triangle)) style |= Panel::Style::HAS_TRIANGLES;
 		if (any(Decoration::Arrow)) style |= Panel::Style::HAS_TRIANGLES;
 	}
-};
 
+private:
+	static const int NUM_SLOTS = NUM_CLASSES * SymbolList::MAX_VARIANTS;
+	static const int WEIGHT_SCALE = 840; //Divisible by every list size up to MAX_VARIANTS, so 1/size is a whole number
+
+	//Slot = class * MAX_VARIANTS + index in the class
+	int weightOf(int slot) const {
+		int symbolClass = slot / SymbolList::MAX_VARIANTS;
+		const SymbolList& list = _symbols[symbolClass];
+		if (symbolClass == STARTS || symbolClass == EXITS || symbolClass == GAPS || symbolClass == ERASERS) return 0;
+		if (static_cast<size_t>(slot % SymbolList::MAX_VARIANTS) >= list.size()) return 0;
+		int amount = list[slot % SymbolList::MAX_VARIANTS].second;
+		return (amount > 0 && amount < 25) ? WEIGHT_SCALE / static_cast<int>(list.size()) : 0;
+	}
+
+	//Fenwick tree over the slot weights, so a weighted pick and the update after it are O(log n)
+	void buildWeights() {
+		_tree.fill(0);
+		_totalWeight = 0;
+		for (int slot = 0; slot < NUM_SLOTS; slot++) addWeight(slot, weightOf(slot));
+		_weightsValid = true;
+	}
+
+	void addWeight(int slot, int delta) {
+		if (delta == 0) return;
+		_totalWeight += delta;
+		for (int i = slot + 1; i <= NUM_SLOTS; i += i & -i) _tree[i] += delta;
+	}
+
+	//The slot whose range of cumulative weight contains target
+	int findSlot(int target) const {
+		int pos = 0;
+		int step = 1;
+		while (step * 2 <= NUM_SLOTS) step *= 2;
+		for (; step > 0; step /= 2) {
+			if (pos + step <= NUM_SLOTS && _tree[pos + step] <= target) {
+				pos += step;
+				target -= _tree[pos];
+			}
+		}
+		return pos;
+	}
+
+	std::array<SymbolList, NUM_CLASSES> _symbols;
+	std::array<int, NUM_SLOTS + 1> _tree;
+	int _totalWeight = 0;
+	bool _weightsValid = false;
+};
@@ -5,4 +5,8 @@
 #include "Random.h"
 #include <time.h>
 
-std::mt19937 Random::gen = std::mt19937((int)time(0));
\ No newline at end of file
+thread_local std::mt19937 Random::gen = std::mt19937((int)time(0));
+std::atomic<bool> Random::_perPanel = false;
+int Random::_baseSeed = 0;
+int Random::_difficulty = 0;
+thread_local std::map<int, int> Random::_variants;
@@ -1,10 +1,14 @@
 #pragma once
 #include <random>
 #include <stdlib.h>
+#include <stdint.h>
+#include <string>
+#include <map>
+#include <atomic>
 
 struct Random {
 
-	static std::mt19937 gen;
+	static thread_local std::mt19937 gen; //Per thread, so areas generated in parallel don't share a stream
 
 	static void seed(int val) {
 		gen = std::mt19937(val);
@@ -14,4 +18,61 @@ struct Random {
 		return abs((int)gen());
 	}
 
+	enum Difficulty { Easy, Normal, Expert };
+
+	//Turn on per-panel seeding. Each panel's stream is derived from (seed, difficulty, panel id, variant) instead of from whatever was generated before it,
+	//so areas can be generated in any order (or on their own) and still come out the same.
+	//Since version 1.4.0 (see App/Version.h) - a seed makes different puzzles than it did in earlier versions.
+	//Call before starting any threads that generate, which only read the seed and difficulty.
+	static void seedPanels(int seed, Difficulty difficulty) {
+		_baseSeed = seed;
+		_difficulty = difficulty;
+		_variants.clear();
+		_perPanel = true;
+	}
+
+	//Count variants from zero again. Called at the start of each area task, so the stream a panel gets only depends on what its own area did before,
+	//not on what other areas (maybe on other threads) did with the same id.
+	static void beginArea() { _variants.clear(); }
+
+	static void disablePanelSeeds() { _perPanel = false; }
+	static bool panelSeedsEnabled() { return _perPanel; }
+
+	//Reseed for the given panel. Every call for the same id (since the last beginArea on this thread) uses the next variant, so retries that throw away a panel get a fresh stream.
+	static void seedPanel(int id) {
+		if (!_perPanel) return;
+		int variant = _variants[id]++;
+		seed(static_cast<int>(deriveSeed(_baseSeed, _difficulty, id, variant)));
+	}
+
+	//Reseed at the start of an area, so the area's own random choices don't depend on the areas before it
+	static void seedArea(const std::wstring& areaName) {
+		uint64_t hash = 0xcbf29ce484222325ULL; //FNV-1a, stable across builds unlike std::hash
+		for (wchar_t c : areaName) {
+			hash ^= static_cast<uint64_t>(c);
+			hash *= 0x100000001b3ULL;
+		}
+		seedPanel(static_cast<int>((hash ^ (hash >> 32)) | 0x80000000)); //High bit keeps area keys apart from panel ids
+	}
+
+	static uint64_t splitmix64(uint64_t x) {
+		x += 0x9e3779b97f4a7c15ULL;
+		x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+		x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+		return x ^ (x >> 31);
+	}
+
+	static uint64_t deriveSeed(int seed, int difficulty, int id, int variant) {
+		uint64_t h = splitmix64(static_cast<uint32_t>(seed));
+		h = splitmix64(h ^ static_cast<uint32_t>(difficulty));
+		h = splitmix64(h ^ static_cast<uint32_t>(id));
+		h = splitmix64(h ^ static_cast<uint32_t>(variant));
+		return h;
+	}
+
+private:
+	static std::atomic<bool> _perPanel;
+	static int _baseSeed;
+	static int _difficulty;
+	static thread_local std::map<int, int> _variants; //Per thread, and reset for each area task
 };
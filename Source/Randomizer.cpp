@@ -23,38 +23,41 @@ std::vector<int> copyWithoutElements(const std::vector<int>& input, const std::v
 	return result;
 }
 
-void Randomizer::GenerateNormal(HWND loadingHandle) {
+void Randomizer::GenerateNormal(WindowHandle loadingHandle) {
 	std::shared_ptr<PuzzleList> puzzles = std::make_shared<PuzzleList>();
 	puzzles->setLoadingHandle(loadingHandle);
 	puzzles->setSeed(seed, seedIsRNG, colorblind);
+	if (version.size() > 0) puzzles->setCache(version, doubleMode);
 	puzzles->GenerateAllN();
 	if (doubleMode) ShufflePanels(false);
 }
 
-void Randomizer::GenerateEasy(HWND loadingHandle) {
+void Randomizer::GenerateEasy(WindowHandle loadingHandle) {
 	std::shared_ptr<PuzzleList> puzzles = std::make_shared<PuzzleList>();
 	puzzles->setLoadingHandle(loadingHandle);
 	puzzles->setSeed(seed, seedIsRNG, colorblind);
+	if (version.size() > 0) puzzles->setCache(version, doubleMode);
 	puzzles->GenerateAllE();
 	if (doubleMode) ShufflePanels(false);
 }
 
-void Randomizer::GenerateHard(HWND loadingHandle) {
+void Randomizer::GenerateHard(WindowHandle loadingHandle) {
 	std::shared_ptr<PuzzleList> puzzles = std::make_shared<PuzzleList>();
 	puzzles->setLoadingHandle(loadingHandle);
 	puzzles->setSeed(seed, seedIsRNG, colorblind);
+	if (version.size() > 0) puzzles->setCache(version, doubleMode);
 	puzzles->GenerateAllH();
 	if (doubleMode) ShufflePanels(true);
-	SetWindowText(loadingHandle, L"Starting watchdogs...");
+	SetStatusText(loadingHandle, L"Starting watchdogs...");
 	Panel::StartArrowWatchdogs(_shuffleMapping);
-	SetWindowText(loadingHandle, L"Done!");
+	SetStatusText(loadingHandle, L"Done!");
 	if (!Special::hasBeenRandomized())
-		MessageBox(GetActiveWindow(), L"Hi there! Thanks for trying out Expert Mode. It will be tough, but I hope you have fun!\r\n\r\n"
+		ShowMessage(L"Hi there! Thanks for trying out Expert Mode. It will be tough, but I hope you have fun!\r\n\r\n"
 		L"Expert has some unique tricks up its sleeve. You will encounter some situations that may seem impossible at first glance (even in tutorial)! "
 		L"In these situations, try to think of alternate approaches that weren't required in the base game.\r\n\r\n"
 		L"For especially tough puzzles, the Solver folder has a solver that works for most puzzles, though it occasionally fails to find a solution.\r\n\r\n"
 		L"The Github wiki also has a Hints page that can help with certain tricky puzzles.\r\n\r\n"
-		L"Thanks for playing, and good luck!", L"Welcome", MB_OK);
+		L"Thanks for playing, and good luck!", L"Welcome");
 }
 
 template <class T>
@@ -63,7 +66,7 @@ int find(const std::vector<T> &data, T search, size_t startIndex = 0) {
 		if (data[i] == search) return static_cast<int>(i);
 	}
 	std::cout << "Couldn't find " << search << " in data!" << std::endl;
-	throw std::exception("Couldn't find value in data!");
+	throw std::runtime_error("Couldn't find value in data!");
 }
 
 void Randomizer::AdjustSpeed() {
@@ -3,12 +3,13 @@
 #include <memory>
 #include <set>
 #include <map>
+#include <string>
 
 class Randomizer {
 public:
-	void GenerateNormal(HWND loadingHandle);
-	void GenerateEasy(HWND loadingHandle);
-	void GenerateHard(HWND loadingHandle);
+	void GenerateNormal(WindowHandle loadingHandle);
+	void GenerateEasy(WindowHandle loadingHandle);
+	void GenerateHard(WindowHandle loadingHandle);
 
 	void AdjustSpeed();
 
@@ -26,6 +27,7 @@ public:
 	bool seedIsRNG = false;
 	bool colorblind = false;
 	bool doubleMode = false;
+	std::string version; //Randomizer version, used to key the puzzle cache. Leave empty to turn the cache off.
 
 private:
 	void RandomizeDesert();
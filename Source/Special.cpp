@@ -5,6 +5,7 @@
 #include "Special.h"
 #include "MultiGenerate.h"
 #include "Quaternion.h"
+#include "PanelStats.h"
 #include "../App/Version.h"
 
 void Special::generateSpecialSymMaze(std::shared_ptr<Generate> gen, int id) {
@@ -92,7 +93,7 @@ void Special::generateReflectionDotPuzzle(std::shared_ptr<Generate> gen, int id1
 	gen->setFlagOnce(Generate::Config::DisableWrite);
 	gen->generate(id1, symbols);
 	std::shared_ptr<Panel> puzzle = gen->_panel;
-	std::shared_ptr<Panel> flippedPuzzle = std::make_shared<Panel>(id2);
+	std::shared_ptr<Panel> flippedPuzzle = Panel::FromTemplate(id2);
 	std::vector<Point> dots;
 	for (int x = 0; x < puzzle->_width; x++) {
 		for (int y = 0; y < puzzle->_height; y++) {
@@ -333,7 +334,9 @@ void Special::generateSoundDotReflectionPuzzle(int id, Point size, std::vector<i
 		generator->generate(id, Decoration::Dot_Intersection | Decoration::Color::Blue, static_cast<int>(dotSequence1.size() - 1), Decoration::Dot_Intersection | Decoration::Color::Yellow, static_cast<int>(dotSequence2.size() - 1));
 	}
 	else if (id == 0x00AFB && writeSequence) { //Shipwreck Expert
-		while (!generateSoundDotReflectionSpecial(id, size, dotSequence1, dotSequence2, numColored));
+		//Each try resets the generator's config, so the only step is a fresh seed
+		Generate::untilSuccess(id, [&]() { return generateSoundDotReflectionSpecial(id, size, dotSequence1, dotSequence2, numColored); },
+			[&](Generate::Relaxation step) { return step == Generate::FreshSeed && generator->relax(step, nullptr); });
 		return;
 	}
 	else generator->generate(id, Decoration::Dot_Intersection | Decoration::Color::Blue, static_cast<int>(dotSequence1.size()), Decoration::Dot_Intersection | Decoration::Color::Yellow, static_cast<int>(dotSequence2.size()));
@@ -731,17 +734,25 @@ void Special::generateKeepLaserPuzzle(int id, const std::set<Point>& path1, cons
 		solution.push_back(row);
 	}
 
-	while (!generator->place_all_symbols(psymbols)) {
+	Generate::untilSuccess(id, [&]() {
+		if (generator->place_all_symbols(psymbols)) return true;
 		for (int x = 0; x < generator->_panel->_width; x++)
 			for (int y = 0; y < generator->_panel->_height; y++)
 				if (generator->get(x, y) != PATH && (generator->get(x, y) & 0x1fffff) != Decoration::Gap)
 					generator->set(x, y, 0);
 		generator->_openpos = generator->_gridpos;
-		for (int i = 0; i < psymbols.symbols[Decoration::Poly].size(); i++) {
-			psymbols.symbols[Decoration::Poly][i].second = psymbolsBackup.symbols[Decoration::Poly][i].second + Random::rand() % 3 - Random::rand() % 3;
-			if (psymbols.symbols[Decoration::Poly][i].second < 1) psymbols.symbols[Decoration::Poly][i].second = 1;
+		for (int i = 0; i < psymbols[Decoration::Poly].size(); i++) {
+			psymbols[Decoration::Poly][i].second = psymbolsBackup[Decoration::Poly][i].second + Random::rand() % 3 - Random::rand() % 3;
+			if (psymbols[Decoration::Poly][i].second < 1) psymbols[Decoration::Poly][i].second = 1;
 		}
-	}
+		return false;
+	}, [&](Generate::Relaxation step) {
+		if (step != Generate::FewerSymbols) return generator->relax(step, nullptr);
+		//Shape sizes are redrawn from the backup on every try, so the symbol comes off the backup and the tries go on from it
+		if (!psymbolsBackup.removeOne()) return false;
+		psymbols = psymbolsBackup;
+		return true;
+	});
 
 	for (int x = 0; x < generator->_panel->_width; x++)
 		for (int y = 0; y < generator->_panel->_height; y++)
@@ -815,9 +826,17 @@ void Special::generateMultiPuzzle(std::vector<int> ids, const std::vector<std::v
 		gens[i].setFlag(Generate::WriteColors);
 		if (symbols[i].getNum(Decoration::Poly)  - symbols[i].getNum(Decoration::Eraser) > 1) gens[i].setFlag(Generate::RequireCombineShapes);
 	}
-	while (!generateMultiPuzzle(ids, gens, symbols, generator->_path)) {
+	Generate::untilSuccess(ids[0], [&]() {
+		if (generateMultiPuzzle(ids, gens, symbols, generator->_path)) return true;
 		generator->generate(ids[0]);
-	}
+		return false;
+	}, [&](Generate::Relaxation step) {
+		if (step != Generate::FewerSymbols) return generator->relax(step, nullptr);
+		//One symbol from each panel, so they stay about as hard as each other
+		bool relaxed = false;
+		for (PuzzleSymbols& s : symbols) relaxed = s.removeOne() || relaxed;
+		return relaxed;
+	});
 	for (int i = 0; i < ids.size(); i++) {
 		gens[i].write(ids[i]);
 		generator->incrementProgress();
@@ -874,7 +893,12 @@ void Special::generate2Bridge(int id1, int id2)
 		g->setFlag(Generate::Config::ShortPath);
 		g->setFlag(Generate::Config::WriteColors);
 	}
-	while (!generate2Bridge(id1, id2, gens));
+	//The symbols have to be exactly these for the eraser trick to work, so the only step is a fresh seed
+	Generate::untilSuccess(id1, [&]() { return generate2Bridge(id1, id2, gens); }, [&](Generate::Relaxation step) {
+		if (step != Generate::FreshSeed) return false;
+		for (std::shared_ptr<Generate> g : gens) g->relax(step, nullptr);
+		return true;
+	});
 	gens[1]->write(id1);
 	gens[1]->write(id2);
 	generator->incrementProgress();
@@ -955,7 +979,11 @@ void Special::generate2BridgeH(int id1, int id2)
 		g->setFlag(Generate::Config::ShortPath);
 		g->setFlag(Generate::Config::WriteColors);
 	}
-	while (!generate2BridgeH(id1, id2, gens));
+	Generate::untilSuccess(id1, [&]() { return generate2BridgeH(id1, id2, gens); }, [&](Generate::Relaxation step) {
+		if (step != Generate::FreshSeed) return false;
+		for (std::shared_ptr<Generate> g : gens) g->relax(step, nullptr);
+		return true;
+	});
 	
 	
 	gens[0]->write(id1);
@@ -1110,20 +1138,28 @@ void Special::generateMountainFloor()
 {
 	std::vector<int> ids = { 0x09EFF, 0x09F01, 0x09FC1, 0x09F8E };
 	int idfloor = 0x09FDA;
-	//{ 0x09EFF, 0x09F01, 0x09FC1, 0x09F8E }, 0x09FDA
+	//The four panels are made from the floor's shapes, so the floor is started over from a fresh seed rather than relaxed
+	Generate::untilSuccess(idfloor, [&]() { return generateMountainFloor(ids, idfloor); },
+		[&](Generate::Relaxation step) { return step == Generate::FreshSeed && generator->relax(step, nullptr); });
+	generator->incrementProgress();
+	generator->resetVars();
+	generator->resetConfig();
+}
+
+bool Special::generateMountainFloor(const std::vector<int>& ids, int idfloor)
+{
 	generator->resetConfig();
 	std::vector<Point> floorPos = { { 3, 3 },{ 7, 3 },{ 3, 7 },{ 7, 7 } };
 	generator->openPos = std::set<Point>(floorPos.begin(), floorPos.end());
 	generator->setFlag(Generate::Config::DisableWrite);
+	generator->generate(idfloor, Decoration::Poly, 4);
 	//Make sure no duplicated symbols
 	std::set<int> sym;
-	do {
-		generator->generate(idfloor, Decoration::Poly, 4);
-		sym.clear();
-		for (Point p : floorPos) sym.insert(generator->get(p));
-	} while (sym.size() < 4);
+	for (Point p : floorPos) sym.insert(generator->get(p));
+	if (sym.size() < 4) return false;
 
 	int rotateIndex = Random::rand() % 3;
+	int decoyFails = 0;
 	for (int i = 0; i < 4; i++) {
 		int symbol = generator->get(floorPos[i]);
 		//Convert to shape
@@ -1133,9 +1169,11 @@ void Special::generateMountainFloor()
 				shape.emplace(Point((j % 4) * 2 + 1, 8 - ((j / 4) * 2 + 1)));
 			}
 		}
-		//Translate randomly
+		//Translate randomly. Some shapes fit nowhere, and then the floor is started over.
 		Shape newShape;
+		int fails = 0;
 		do {
+			if (fails++ == 50) return false;
 			Point shift = Point((Random::rand() % 4) * 2, -(Random::rand() % 4) * 2);
 			newShape.clear();
 			for (Point p : shape) newShape.insert(p + shift);
@@ -1159,7 +1197,11 @@ void Special::generateMountainFloor()
 		gen.setPath({ {0, 0} }); //Just to stop it from trying to make a path
 		gen.setFlag(Generate::Config::DecorationsOnly);
 		gen.setFlag(Generate::Config::DisableWrite);
-		if (i == rotateIndex) gen.generate(ids[i], { });
+		//A panel whose decoy keeps covering the shape goes without one, like the rotated panel
+		if (i == rotateIndex || decoyFails == 50) {
+			if (i != rotateIndex) PanelStats::recordRelaxation(ids[i], Generate::FewerSymbols);
+			gen.generate(ids[i], { });
+		}
 		else
 		{
 			gen.generate(ids[i], Decoration::Poly, 1, Decoration::Eraser | Decoration::Color::Green, 1);
@@ -1173,6 +1215,7 @@ void Special::generateMountainFloor()
 					}
 			for (Point p : covered) newShape.erase(p);
 			if (newShape.size() == 0 || decoyShape == symbol) {
+				decoyFails++;
 				i--;
 				continue;
 			}
@@ -1180,16 +1223,23 @@ void Special::generateMountainFloor()
 		Point pos = pick_random(newShape);
 		gen.setVal(symbol, pos.first, pos.second);
 		gen.write(ids[i]);
+		decoyFails = 0;
 	}
-	generator->incrementProgress();
-	generator->resetVars();
-	generator->resetConfig();
+	return true;
 }
 
 void Special::generateMountainFloorH()
 {
 	const std::vector<int> ids = { 0x09EFF, 0x09F01, 0x09FC1, 0x09F8E };
 	const int idfloor = 0x09FDA;
+	Generate::untilSuccess(idfloor, [&]() { return generateMountainFloorH(ids, idfloor); },
+		[&](Generate::Relaxation step) { return step == Generate::FreshSeed && generator->relax(step, nullptr); });
+	generator->write(idfloor);
+	generator->resetConfig();
+}
+
+bool Special::generateMountainFloorH(const std::vector<int>& ids, int idfloor)
+{
 	generator->resetConfig();
 	std::vector<Point> floorPos = { { 3, 3 },{ 7, 3 },{ 3, 7 },{ 7, 7 } };
 	generator->openPos = std::set<Point>(floorPos.begin(), floorPos.end());
@@ -1198,15 +1248,13 @@ void Special::generateMountainFloorH()
 	generator->setSymmetry(Panel::Symmetry::Rotational);
 	generator->setSymbol(Decoration::Start, 0, 10); generator->setSymbol(Decoration::Start, 10, 0);
 	generator->setSymbol(Decoration::Exit, 0, 0); generator->setSymbol(Decoration::Exit, 10, 10);
+	generator->generate(idfloor, Decoration::Poly, 6);
 	//Make sure no duplicated symbols
 	std::set<int> sym;
-	do {
-		generator->generate(idfloor, Decoration::Poly, 6);
-		sym.clear();
-		for (Point p : floorPos) sym.insert(generator->get(p));
-	} while (sym.size() < 4);
+	for (Point p : floorPos) sym.insert(generator->get(p));
+	if (sym.size() < 4) return false;
 
-	int combine = 0;
+	int combine = 0, retries = 0;
 	for (int i = 0; i < 4; i++) {
 		int symbol = generator->get(floorPos[i]);
 		//Convert to shape
@@ -1220,10 +1268,7 @@ void Special::generateMountainFloorH()
 		Shape newShape;
 		int fails = 0;
 		do {
-			if (fails++ == 50) {
-				generateMountainFloorH();
-				return;
-			}
+			if (fails++ == 50) return false;
 			Point shift = Point((Random::rand() % 4) * 2, -(Random::rand() % 4) * 2);
 			newShape.clear();
 			for (Point p : shape) newShape.insert(p + shift);
@@ -1250,10 +1295,7 @@ void Special::generateMountainFloorH()
 		}
 		fails = 0;
 		while (!gen.generate(ids[i], symbols)) {
-			if (fails++ > 50) {
-				generateMountainFloorH();
-				return;
-			}
+			if (fails++ > 50) return false;
 		}
 		//Check that the symbols made it into the shape
 		int count = 0;
@@ -1262,6 +1304,7 @@ void Special::generateMountainFloorH()
 			if (gen.get_symbol_type(gen.get(p)) == Decoration::Eraser) count--;
 		}
 		if (count != (newShape.size() > 5 ? combine == 2 ? 4 : 2 : 1)) {
+			if (retries++ == 50) return false;
 			i--;
 			if (newShape.size() > 5) combine--;
 			continue;
@@ -1272,19 +1315,16 @@ void Special::generateMountainFloorH()
 			if (gen.get_symbol_type(gen.get(p)) == Decoration::Poly) symbolSet.insert(gen.get(p));
 		}
 		if (symbolSet.size() <= 1) {
+			if (retries++ == 50) return false;
 			i--;
 			if (newShape.size() > 5) combine--;
 			continue;
 		}
 		gen.write(ids[i]);
 	}
-	if (combine != 2) {
-		generateMountainFloorH();
-		return;
-	}
+	if (combine != 2) return false;
 	for (Point p : floorPos) generator->set(p, Decoration::Poly);
-	generator->write(idfloor);
-	generator->resetConfig();
+	return true;
 }
 
 void Special::generatePivotPanel(int id, Point gridSize, const std::vector<std::pair<int, int>>& symbolVec, bool colorblind) {
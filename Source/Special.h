@@ -3,6 +3,7 @@
 #include "Randomizer.h"
 #include "Watchdog.h"
 #include <algorithm>
+#include <cstring>
 #include "Random.h"
 
 typedef std::set<Point> Shape;
@@ -50,7 +51,9 @@ public:
 	void generate2BridgeH(int id1, int id2);
 	bool generate2BridgeH(int id1, int id2, std::vector<std::shared_ptr<Generate>> gens);
 	void generateMountainFloor();
+	bool generateMountainFloor(const std::vector<int>& ids, int idfloor);
 	void generateMountainFloorH();
+	bool generateMountainFloorH(const std::vector<int>& ids, int idfloor);
 	void generatePivotPanel(int id, Point gridSize, const std::vector<std::pair<int, int>>& symbolVec, bool colorblind); //Too slow right now, only used a couple times in hard mode
 	void modifyGate(int id);
 	void addDecoyExits(std::shared_ptr<Generate> gen, int amount);
@@ -171,7 +174,7 @@ public:
 		itemb.resize(sizeof(T));
 		std::memcpy(&itemb[0], &item, sizeof(T));
 		for (address = startAddress; address < startAddress + length; address += 1024) {
-			if (!memory.Read(reinterpret_cast<LPCVOID>(address), &bytes[0], 1024))
+			if (!memory.Read(reinterpret_cast<const void*>(address), &bytes[0], 1024))
 				continue;
 			for (int i = 0; i < bytes.size() - itemb.size(); i += sizeof(T)) {
 				if (std::equal(bytes.begin() + i, bytes.begin() + i + sizeof(T), itemb.begin()))
@@ -190,7 +193,7 @@ public:
 		itemb.resize(sizeof(T) - 1);
 		std::memcpy(&itemb[0], &item, sizeof(T) - 1);
 		for (address = startAddress; address < startAddress + length; address += 1024) {
-			if (!memory.Read(reinterpret_cast<LPCVOID>(address), &bytes[0], 1024))
+			if (!memory.Read(reinterpret_cast<const void*>(address), &bytes[0], 1024))
 				continue;
 			for (int i = 0; i < bytes.size() - itemb.size() + 1; i += sizeof(T)) {
 				if (std::equal(bytes.begin() + i, bytes.begin() + i + sizeof(T) - 1, itemb.begin()))
@@ -0,0 +1,54 @@
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+
+// PVS-Studio Static Code Analyzer for C, C++, C#, and Java: http://www.viva64.com
+
+#include "StageStats.h"
+#include <fstream>
+#include <iomanip>
+
+std::map<int, std::array<StageStats::Counts, StageStats::NUM_STAGES>> StageStats::_recorded;
+std::atomic<bool> StageStats::_enabled = false;
+std::string StageStats::_file;
+std::mutex StageStats::_mutex;
+
+namespace {
+	const char* STAGE_NAMES[] = { "Shapes", "Stones", "Triangles", "Arrows", "Stars", "StarZigzag", "Erasers", "Dots", "Gaps" };
+}
+
+const char* StageStats::name(Stage stage)
+{
+	return stage >= 0 && stage < NUM_STAGES ? STAGE_NAMES[stage] : "?";
+}
+
+void StageStats::enable(const std::string& file)
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	_file = file;
+	_enabled = true;
+}
+
+void StageStats::record(int panel, Stage stage, bool success)
+{
+	if (!_enabled) return;
+	std::lock_guard<std::mutex> lock(_mutex);
+	Counts& counts = _recorded[panel][stage];
+	counts.attempts++;
+	if (!success) counts.failures++;
+}
+
+void StageStats::writeReport()
+{
+	if (!_enabled) return;
+	std::lock_guard<std::mutex> lock(_mutex);
+	std::ofstream out(_file);
+	if (!out.is_open()) return;
+	out << std::fixed << std::setprecision(3);
+	out << "panel, stage, attempts, failures, failure rate" << std::endl;
+	for (const auto& [panel, stages] : _recorded) {
+		for (int stage = 0; stage < NUM_STAGES; stage++) {
+			if (stages[stage].attempts == 0) continue;
+			out << "0x" << std::hex << std::setw(5) << std::setfill('0') << panel << std::dec << std::setfill(' ') << ", " << STAGE_NAMES[stage] << ", " <<
+				stages[stage].attempts << ", " << stages[stage].failures << ", " << static_cast<double>(stages[stage].failures) / stages[stage].attempts << std::endl;
+		}
+	}
+}
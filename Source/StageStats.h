@@ -0,0 +1,33 @@
+#pragma once
+#include <mutex>
+#include <string>
+#include <map>
+#include <array>
+#include <atomic>
+#include <stdint.h>
+
+//How often each placement stage of Generate fails, per panel, for finding the recipes that waste the most attempts. Only recorded once enabled (DEBUG builds).
+//Nothing reads the numbers back: generation never depends on them, so a seed makes the same puzzles whether or not they are recorded.
+class StageStats
+{
+public:
+	enum Stage { Shapes, Stones, Triangles, Arrows, Stars, StarZigzag, Erasers, Dots, Gaps, NUM_STAGES };
+
+	//Start recording. writeReport writes everything recorded so far to file.
+	static void enable(const std::string& file);
+	static bool enabled() { return _enabled; }
+	static void record(int panel, Stage stage, bool success);
+	static void writeReport();
+
+	static const char* name(Stage stage);
+
+private:
+	struct Counts {
+		uint32_t attempts = 0, failures = 0;
+	};
+
+	static std::map<int, std::array<Counts, NUM_STAGES>> _recorded;
+	static std::atomic<bool> _enabled;
+	static std::string _file;
+	static std::mutex _mutex;
+};
@@ -0,0 +1,55 @@
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+
+// PVS-Studio Static Code Analyzer for C, C++, C#, and Java: http://www.viva64.com
+
+#include "SyntheticPanel.h"
+#include "Panel.h"
+#include "Memory.h"
+#include "MemoryImage.h"
+
+uintptr_t SyntheticPanel::_table = 0;
+int SyntheticPanel::_nextId = SyntheticPanel::FIRST_ID;
+std::mutex SyntheticPanel::_mutex;
+
+int SyntheticPanel::Create(int width, int height, bool pillar)
+{
+	int id;
+	uintptr_t data = 0;
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		if (!_table) {
+			//Memory finds panel i at [[[base + GLOBALS] + 0x18] + i * 8]
+			MemoryImage::LoadBlank(GLOBALS);
+			uintptr_t globals = MemoryImage::Alloc(0x20);
+			_table = MemoryImage::Alloc(static_cast<size_t>(FIRST_ID + MAX_PANELS) * sizeof(uintptr_t));
+			MemoryImage::Write(MemoryImage::BaseAddress() + GLOBALS, &globals, sizeof(uintptr_t));
+			MemoryImage::Write(globals + 0x18, &_table, sizeof(uintptr_t));
+		}
+		if (_nextId == FIRST_ID + MAX_PANELS) throw std::runtime_error("Too many synthetic panels");
+		id = _nextId++;
+		data = MemoryImage::Alloc(PANEL_SIZE);
+		MemoryImage::Write(_table + static_cast<uintptr_t>(id) * sizeof(uintptr_t), &data, sizeof(uintptr_t));
+	}
+
+	Panel panel;
+	panel.id = id;
+	panel._width = pillar ? width * 2 : width * 2 + 1;
+	panel._height = height * 2 + 1;
+	panel._grid.assign(panel._width, std::vector<int>(panel._height, 0)); //Every segment is connected
+	panel._startpoints = { { 0, panel._height - 1 } };
+	panel._endpoints = { Endpoint(pillar ? 0 : panel._width - 1, 0, Endpoint::Direction::UP, IntersectionFlags::ENDPOINT) };
+	panel.minx = panel.miny = 0.1f;
+	panel.maxx = panel.maxy = 0.9f;
+	panel.symmetry = Panel::Symmetry::None;
+	panel._style = 0;
+	Point::pillarWidth = pillar ? panel._width : 0;
+
+	panel._memory->WritePanelData<int>(id, GRID_SIZE_X, { (panel._width + 1) / 2 });
+	panel._memory->WritePanelData<int>(id, GRID_SIZE_Y, { (panel._height + 1) / 2 });
+	panel._memory->WritePanelData<int>(id, IS_CYLINDER, { pillar ? 1 : 0 });
+	panel.WriteIntersections();
+	panel._memory->WritePanelData<int>(id, NUM_DECORATIONS, { 0 });
+	panel._memory->WritePanelData<int>(id, STYLE_FLAGS, { panel._style });
+	Point::pillarWidth = 0;
+	return id;
+}
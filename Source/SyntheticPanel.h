@@ -0,0 +1,24 @@
+#pragma once
+#include <mutex>
+#include <stdint.h>
+
+//Puzzles that don't exist in the game, for benchmarks and tests that run without it or a recorded image (see the Bench project).
+//Each one is an empty grid with a start in the bottom left corner and an exit in the top right, written into a blank MemoryImage,
+//so Generate reads and writes it like a real panel. Creating the first one replaces whatever image was loaded with the blank one.
+class SyntheticPanel
+{
+public:
+	//Add an empty grid of width x height cells and return its panel id. A pillar wraps around horizontally, like the ones in the mountain.
+	static int Create(int width, int height, bool pillar = false);
+
+	static const int FIRST_ID = 0x50000; //Past every panel in the game, so no generator special case applies to them
+	static const int MAX_PANELS = 0x10000;
+
+private:
+	static uintptr_t _table; //Address of the panel pointer table in the blank image
+	static int _nextId;
+	static std::mutex _mutex;
+
+	static const int GLOBALS = 0x1000;
+	static const int PANEL_SIZE = 0x600;
+};
@@ -0,0 +1,72 @@
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+
+// PVS-Studio Static Code Analyzer for C, C++, C#, and Java: http://www.viva64.com
+
+#include "TaskGraph.h"
+#include <chrono>
+
+int TaskGraph::addTask(const std::function<void()>& task, const std::vector<int>& dependencies)
+{
+	int index = static_cast<int>(_tasks.size());
+	_tasks.push_back({ task, static_cast<int>(dependencies.size()), {} });
+	for (int dep : dependencies) _tasks[dep].dependents.push_back(index);
+	return index;
+}
+
+void TaskGraph::run(int numThreads, const std::function<void()>& onWait, int waitMillis)
+{
+	if (_tasks.size() == 0) return;
+	if (numThreads < 1) numThreads = 1;
+	_ready.clear();
+	_error = nullptr;
+	for (size_t i = 0; i < _tasks.size(); i++) {
+		if (_tasks[i].waitingOn == 0) _ready.push_back(static_cast<int>(i));
+	}
+	_unfinished = _tasks.size();
+	std::vector<std::thread> workers;
+	for (size_t i = 0; i < static_cast<size_t>(numThreads) && i < _tasks.size(); i++) workers.emplace_back(&TaskGraph::work, this);
+	{
+		std::unique_lock<std::mutex> lock(_mutex);
+		while (_unfinished > 0 && !_error) {
+			_allDone.wait_for(lock, std::chrono::milliseconds(waitMillis));
+			if (onWait) {
+				lock.unlock();
+				onWait();
+				lock.lock();
+			}
+		}
+	}
+	for (std::thread& worker : workers) worker.join();
+	if (_error) std::rethrow_exception(_error);
+}
+
+void TaskGraph::work()
+{
+	std::unique_lock<std::mutex> lock(_mutex);
+	while (true) {
+		_taskReady.wait(lock, [this] { return _ready.size() > 0 || _unfinished == 0 || _error; });
+		if (_unfinished == 0 || _error) return;
+		int index = _ready.front();
+		_ready.pop_front();
+		lock.unlock();
+		std::exception_ptr error = nullptr;
+		try {
+			_tasks[index].run();
+		}
+		catch (...) {
+			error = std::current_exception();
+		}
+		lock.lock();
+		if (error) {
+			if (!_error) _error = error;
+		}
+		else {
+			for (int next : _tasks[index].dependents) {
+				if (--_tasks[next].waitingOn == 0) _ready.push_back(next);
+			}
+			_unfinished--;
+		}
+		_taskReady.notify_all();
+		if (_unfinished == 0 || _error) _allDone.notify_all();
+	}
+}
@@ -0,0 +1,38 @@
+#pragma once
+#include <functional>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+
+//Runs a set of tasks on a pool of worker threads. A task is started once every task it depends on has finished.
+class TaskGraph
+{
+public:
+	//Add a task. dependencies - indices returned by earlier calls to addTask. Returns the index of the new task.
+	int addTask(const std::function<void()>& task, const std::vector<int>& dependencies = {});
+
+	//Run every task and block until they have all finished. onWait is called on the calling thread every waitMillis while it waits.
+	//If a task throws, no more tasks are started and the first exception is rethrown once the running tasks are done.
+	void run(int numThreads, const std::function<void()>& onWait = nullptr, int waitMillis = 100);
+
+	size_t size() { return _tasks.size(); }
+
+private:
+	struct Task {
+		std::function<void()> run;
+		int waitingOn;
+		std::vector<int> dependents;
+	};
+
+	void work();
+
+	std::vector<Task> _tasks;
+	std::deque<int> _ready;
+	size_t _unfinished = 0;
+	std::exception_ptr _error;
+	std::mutex _mutex;
+	std::condition_variable _taskReady, _allDone;
+};
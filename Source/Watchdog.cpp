@@ -5,20 +5,441 @@
 #include "Watchdog.h"
 #include "Quaternion.h"
 #include <thread>
+#include <algorithm>
 
 void Watchdog::start()
 {
-	std::thread{ &Watchdog::run, this }.detach();
+	{
+		std::lock_guard<std::mutex> lock(_recordMutex);
+		if (_recording && Panel::areaGenerated) Panel::areaGenerated->watchdogs.push_back(getRecord());
+		else if (_recording) _records.push_back(getRecord());
+	}
+	WatchdogScheduler::add(this);
+}
+
+Watchdog* Watchdog::fromRecord(const std::vector<int>& record)
+{
+	if (record.size() == 0) return nullptr;
+	switch (record[0]) {
+	case Type::Keep: return new KeepWatchdog();
+	case Type::Arrow: if (record.size() == 3) return new ArrowWatchdog(record[1], record[2]); break;
+	case Type::Bridge: if (record.size() == 3) return new BridgeWatchdog(record[1], record[2]); break;
+	case Type::Treehouse: if (record.size() == 2) return new TreehouseWatchdog(record[1]); break;
+	case Type::Jungle:
+		if (record.size() >= 3 && record[2] >= 0 && static_cast<size_t>(record[2]) <= record.size() - 3) {
+			std::vector<int> seq1(record.begin() + 3, record.begin() + 3 + record[2]);
+			std::vector<int> seq2(record.begin() + 3 + record[2], record.end());
+			return new JungleWatchdog(record[1], seq1, seq2);
+		}
+		break;
+	case Type::TownDoor: return new TownDoorWatchdog();
+	}
+	return nullptr;
+}
+
+Watchdog* Watchdog::fromState(const std::vector<int>& record, const std::vector<int>& state)
+{
+	if (record.size() == 3 && record[0] == Type::Arrow) {
+		if (!ArrowWatchdog::validState(state)) return nullptr;
+		return new ArrowWatchdog(record[1], record[2], state);
+	}
+	Watchdog* watchdog = fromRecord(record);
+	if (watchdog && !watchdog->setState(state)) {
+		delete watchdog;
+		return nullptr;
+	}
+	return watchdog;
 }
 
-void Watchdog::run()
+void Watchdog::startRecording()
 {
-	while (!terminate) {
-		std::this_thread::sleep_for(std::chrono::milliseconds(static_cast<int>(sleepTime * 1000)));
-		action();
+	std::lock_guard<std::mutex> lock(_recordMutex);
+	_records.clear();
+	_recording = true;
+}
+
+std::vector<std::vector<int>> Watchdog::stopRecording()
+{
+	std::lock_guard<std::mutex> lock(_recordMutex);
+	_recording = false;
+	std::vector<std::vector<int>> records;
+	records.swap(_records);
+	return records;
+}
+
+bool Watchdog::_recording = false;
+std::vector<std::vector<int>> Watchdog::_records;
+std::mutex Watchdog::_recordMutex;
+
+//Watchdog Scheduler
+
+namespace {
+	std::chrono::steady_clock::duration seconds(float time) {
+		return std::chrono::microseconds(static_cast<long long>(time * 1000000));
 	}
 }
 
+void WatchdogScheduler::add(Watchdog* watchdog)
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	if (_stopping) {
+		delete watchdog;
+		return;
+	}
+	std::vector<int> record = watchdog->getRecord();
+	if (record.size() > 0) watchdog->_type = record[0];
+	schedule(watchdog, std::chrono::steady_clock::now() + seconds(watchdog->sleepTime));
+	_live.insert(watchdog);
+	_registryDirty = true;
+	if (!_thread.joinable()) _thread = std::thread(&WatchdogScheduler::run);
+	_wake.notify_one();
+}
+
+void WatchdogScheduler::cancel(Watchdog* watchdog)
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	watchdog->terminate = true; //Dropped the next time it comes up
+	_wake.notify_one();
+}
+
+void WatchdogScheduler::stop()
+{
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_stopping = true;
+		_wake.notify_one();
+	}
+	if (_thread.joinable()) _thread.join();
+	WatchdogStats::writeLog();
+	std::lock_guard<std::mutex> lock(_mutex);
+	if (_memory) WatchdogRegistry::Save(_registryKey, registryItems()); //So they can be restored if the randomizer is opened again
+	while (_queue.size() > 0) _queue.pop();
+	for (Watchdog* watchdog : _live) delete watchdog;
+	_live.clear();
+	_idle.clear();
+}
+
+void WatchdogScheduler::cancelAll()
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	for (Watchdog* watchdog : _live) watchdog->terminate = true;
+	_registryDirty = true;
+	_wake.notify_one();
+}
+
+int WatchdogScheduler::restore()
+{
+	getMemory();
+	std::vector<WatchdogRegistry::Item> items;
+	if (!WatchdogRegistry::Load(_registryKey, items)) return 0;
+	int restored = 0;
+	for (const WatchdogRegistry::Item& item : items) {
+		Watchdog* watchdog = Watchdog::fromState(item.record, item.state);
+		if (!watchdog) continue;
+		add(watchdog);
+		restored++;
+	}
+	return restored;
+}
+
+void WatchdogScheduler::setPollBounds(const PollBounds& bounds)
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	_bounds = bounds;
+	_wake.notify_one();
+}
+
+PollBounds WatchdogScheduler::getPollBounds()
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	return _bounds;
+}
+
+std::shared_ptr<Memory> WatchdogScheduler::getMemory()
+{
+	std::lock_guard<std::recursive_mutex> lock(memoryMutex);
+	if (!_memory) {
+		_memory = std::make_shared<Memory>("witness64_d3d11.exe");
+		_memory->setDirect(true); //Watchdogs act on the game as it is now, even while a randomization is being staged
+		_registryKey = { _memory->GetProcessId(), _memory->GetProcessStartTime(), Memory::GLOBALS };
+	}
+	return _memory;
+}
+
+//Exceptions from action() are deliberately not caught: a failed read means the game has closed, and that should take the randomizer down with it
+void WatchdogScheduler::run()
+{
+	std::unique_lock<std::mutex> lock(_mutex);
+	while (!_stopping) {
+		TimePoint wakeTime = TimePoint::max();
+		if (_queue.size() > 0) wakeTime = _queue.top().first;
+		if (_idle.size() > 0 && _nextProbe < wakeTime) wakeTime = _nextProbe;
+		if (wakeTime == TimePoint::max()) {
+			_wake.wait(lock);
+			continue;
+		}
+		if (std::chrono::steady_clock::now() < wakeTime) {
+			_wake.wait_until(lock, wakeTime); //Woken early if a watchdog is added, cancelled or we're stopping
+			continue;
+		}
+		PollBounds bounds = _bounds;
+		//Take everything that is due, so their fields can be polled together
+		std::vector<Watchdog*> due;
+		TimePoint now = std::chrono::steady_clock::now();
+		while (_queue.size() > 0 && _queue.top().first <= now) {
+			Entry entry = _queue.top();
+			_queue.pop();
+			Watchdog* watchdog = entry.second;
+			watchdog->_queued--;
+			if (watchdog->terminate) {
+				if (watchdog->_queued == 0) release(watchdog);
+			}
+			else if (entry.first == watchdog->_due) due.push_back(watchdog);
+		}
+		bool probing = _idle.size() > 0 && _nextProbe <= now;
+		if (probing) _nextProbe = alignToTick(now + seconds(bounds.probeInterval), bounds);
+		lock.unlock();
+		{
+			std::lock_guard<std::recursive_mutex> memoryLock(memoryMutex);
+			if (probing) {
+				for (Watchdog* watchdog : probe(now)) {
+					if (std::find(due.begin(), due.end(), watchdog) == due.end()) due.push_back(watchdog);
+				}
+			}
+			std::shared_ptr<const GameSnapshot> snapshot = poll(due);
+			for (Watchdog* watchdog : due) {
+				watchdog->_snapshot = snapshot;
+				watchdog->_written.clear();
+				watchdog->_readBytes = 0;
+				watchdog->_lastWrite = TimePoint();
+				watchdog->action();
+				watchdog->_snapshot = nullptr;
+				if (WatchdogStats::enabled()) recordStats(watchdog);
+			}
+		}
+		WatchdogStats::flush();
+		lock.lock();
+		now = std::chrono::steady_clock::now();
+		for (Watchdog* watchdog : due) {
+			if (watchdog->_stateChanged) {
+				watchdog->_stateChanged = false;
+				_registryDirty = true;
+			}
+			if (watchdog->terminate) {
+				_idle.erase(watchdog);
+				watchdog->_due = TimePoint(); //Any entries still queued are superseded
+				if (watchdog->_queued == 0) release(watchdog);
+			}
+			else reschedule(watchdog, now, bounds);
+		}
+		//Saving is rate limited, since some watchdogs change state on every step of a traced line
+		if (_registryDirty && now >= _nextSave) {
+			std::vector<WatchdogRegistry::Item> items = registryItems();
+			_registryDirty = false;
+			_nextSave = now + std::chrono::seconds(5);
+			lock.unlock();
+			WatchdogRegistry::Save(_registryKey, items);
+			lock.lock();
+		}
+	}
+}
+
+std::vector<WatchdogRegistry::Item> WatchdogScheduler::registryItems()
+{
+	std::vector<WatchdogRegistry::Item> items;
+	for (Watchdog* watchdog : _live) {
+		if (!watchdog->terminate) items.push_back({ watchdog->getRecord(), watchdog->getState() });
+	}
+	return items;
+}
+
+//Read the union of the watched fields once, and publish them as the latest snapshot
+std::shared_ptr<const GameSnapshot> WatchdogScheduler::poll(const std::vector<Watchdog*>& watchdogs)
+{
+	std::map<std::pair<int, int>, int> wanted; //(panel, offset) -> size
+	for (Watchdog* watchdog : watchdogs) {
+		for (const WatchedField& field : watchdog->watchedFields()) {
+			int& size = wanted[std::make_pair(field.panel, field.offset)];
+			size = max(size, field.size);
+		}
+	}
+	std::shared_ptr<const GameSnapshot> snapshot = readFields(wanted, std::chrono::steady_clock::now());
+	std::atomic_store(&_snapshot, snapshot);
+	return snapshot;
+}
+
+//Fields of the same panel that are close together are fetched in a single read. Every traced length that goes past is noted for the activity model.
+std::shared_ptr<GameSnapshot> WatchdogScheduler::readFields(const std::map<std::pair<int, int>, int>& wanted, TimePoint now)
+{
+	std::shared_ptr<GameSnapshot> snapshot = std::make_shared<GameSnapshot>();
+	size_t bytesRead = 0;
+	for (auto it = wanted.begin(); it != wanted.end();) {
+		int panel = it->first.first;
+		int start = it->first.second;
+		int end = start + it->second;
+		auto last = it;
+		for (last++; last != wanted.end() && last->first.first == panel && last->first.second <= end + 0x40; last++) {
+			end = max(end, last->first.second + last->second);
+		}
+		std::vector<byte> block = _memory->ReadPanelData<byte>(panel, start, end - start);
+		bytesRead += block.size();
+		for (; it != last; it++) {
+			int offset = it->first.second - start;
+			snapshot->fields[it->first] = std::vector<byte>(block.begin() + offset, block.begin() + offset + it->second);
+		}
+	}
+	for (const auto& [key, bytes] : snapshot->fields) {
+		if (key.second != TRACED_EDGES || bytes.size() < sizeof(int)) continue;
+		int length;
+		memcpy(&length, &bytes[0], sizeof(int));
+		auto search = _traced.find(key.first);
+		if (search == _traced.end()) {
+			_traced[key.first] = { length, TimePoint(), TimePoint(), now }; //First sighting - a line left over from before isn't activity
+			continue;
+		}
+		TracedLine& line = search->second;
+		if (line.length != length) {
+			line.length = length;
+			line.before = line.lastRead;
+			line.changed = now;
+		}
+		line.lastRead = now;
+	}
+	WatchdogStats::recordPoll(bytesRead);
+	return snapshot;
+}
+
+//Check the traced length of every idle panel in one go. Returns the watchdogs whose panel has started changing.
+std::vector<Watchdog*> WatchdogScheduler::probe(TimePoint now)
+{
+	std::map<std::pair<int, int>, int> wanted;
+	for (Watchdog* watchdog : _idle) {
+		for (int panel : watchdog->activityPanels()) wanted[std::make_pair(panel, TRACED_EDGES)] = sizeof(int);
+	}
+	readFields(wanted, now);
+	std::vector<Watchdog*> promoted;
+	for (Watchdog* watchdog : _idle) {
+		if (watchdog->terminate) continue;
+		for (int panel : watchdog->activityPanels()) {
+			if (_traced[panel].changed == now) {
+				promoted.push_back(watchdog);
+				break;
+			}
+		}
+	}
+	for (Watchdog* watchdog : promoted) _idle.erase(watchdog);
+	return promoted;
+}
+
+void WatchdogScheduler::reschedule(Watchdog* watchdog, TimePoint now, const PollBounds& bounds)
+{
+	if (watchdog->activityPanels().size() == 0) {
+		_idle.erase(watchdog);
+		schedule(watchdog, alignToTick(now + seconds(max(watchdog->sleepTime, bounds.minInterval)), bounds));
+	}
+	else if (isActive(watchdog, now, bounds)) {
+		_idle.erase(watchdog);
+		schedule(watchdog, now + seconds(max(bounds.minInterval, min(watchdog->sleepTime, bounds.activeInterval))));
+	}
+	else {
+		_idle.insert(watchdog);
+		schedule(watchdog, alignToTick(now + seconds(max(watchdog->sleepTime, bounds.heartbeat)), bounds));
+		if (_nextProbe <= now) _nextProbe = alignToTick(now + seconds(bounds.probeInterval), bounds);
+	}
+}
+
+void WatchdogScheduler::schedule(Watchdog* watchdog, TimePoint due)
+{
+	if (watchdog->_queued > 0 && watchdog->_due == due) return;
+	watchdog->_due = due;
+	watchdog->_queued++;
+	_queue.emplace(due, watchdog);
+}
+
+void WatchdogScheduler::release(Watchdog* watchdog)
+{
+	_idle.erase(watchdog);
+	_live.erase(watchdog);
+	_registryDirty = true;
+	delete watchdog;
+}
+
+bool WatchdogScheduler::isActive(Watchdog* watchdog, TimePoint now, const PollBounds& bounds)
+{
+	for (int panel : watchdog->activityPanels()) {
+		auto search = _traced.find(panel);
+		if (search != _traced.end() && search->second.changed != TimePoint() && now - search->second.changed < seconds(bounds.activeHold)) return true;
+	}
+	return false;
+}
+
+//A write answers the latest change to the watchdog's traced lines, if that change hasn't been answered already
+void WatchdogScheduler::recordStats(Watchdog* watchdog)
+{
+	WatchdogStats::recordAction(watchdog->_type, watchdog->_readBytes);
+	if (watchdog->_lastWrite == TimePoint()) return;
+	const TracedLine* latest = nullptr;
+	for (int panel : watchdog->activityPanels()) {
+		auto search = _traced.find(panel);
+		if (search != _traced.end() && (!latest || search->second.changed > latest->changed)) latest = &search->second;
+	}
+	if (!latest || latest->changed <= watchdog->_responded) return;
+	watchdog->_responded = latest->changed;
+	WatchdogStats::recordLatency(watchdog->_type, latest->changed - latest->before, watchdog->_lastWrite - latest->changed);
+}
+
+//Round up to the next probe tick, so watchdogs that aren't in a hurry wake up together
+WatchdogScheduler::TimePoint WatchdogScheduler::alignToTick(TimePoint time, const PollBounds& bounds)
+{
+	std::chrono::microseconds tick(static_cast<long long>(bounds.probeInterval * 1000000));
+	if (tick.count() <= 0) return time;
+	std::chrono::microseconds sinceEpoch = std::chrono::duration_cast<std::chrono::microseconds>(time.time_since_epoch());
+	return TimePoint(((sinceEpoch + tick - std::chrono::microseconds(1)) / tick) * tick);
+}
+
+std::recursive_mutex WatchdogScheduler::memoryMutex;
+std::priority_queue<WatchdogScheduler::Entry, std::vector<WatchdogScheduler::Entry>, std::greater<WatchdogScheduler::Entry>> WatchdogScheduler::_queue;
+std::shared_ptr<Memory> WatchdogScheduler::_memory;
+std::shared_ptr<const GameSnapshot> WatchdogScheduler::_snapshot;
+std::mutex WatchdogScheduler::_mutex;
+std::condition_variable WatchdogScheduler::_wake;
+std::thread WatchdogScheduler::_thread;
+bool WatchdogScheduler::_stopping = false;
+PollBounds WatchdogScheduler::_bounds;
+WatchdogScheduler::TimePoint WatchdogScheduler::_nextProbe;
+std::set<Watchdog*> WatchdogScheduler::_idle;
+std::map<int, WatchdogScheduler::TracedLine> WatchdogScheduler::_traced;
+std::set<Watchdog*> WatchdogScheduler::_live;
+WatchdogRegistry::Key WatchdogScheduler::_registryKey = {};
+bool WatchdogScheduler::_registryDirty = false;
+WatchdogScheduler::TimePoint WatchdogScheduler::_nextSave;
+
+uint64_t ChangeDetector::hash(const void* data, size_t numBytes)
+{
+	const uint64_t PRIME1 = 0x9E3779B185EBCA87ULL, PRIME2 = 0xC2B2AE3D27D4EB4FULL, PRIME3 = 0x165667B19E3779F9ULL, PRIME4 = 0x85EBCA77C2B2AE63ULL;
+	const byte* bytes = static_cast<const byte*>(data);
+	uint64_t h = PRIME3 + numBytes;
+	size_t i = 0;
+	for (; i + 8 <= numBytes; i += 8) {
+		uint64_t k;
+		memcpy(&k, bytes + i, 8);
+		k *= PRIME2;
+		k = (k << 31) | (k >> 33);
+		h ^= k * PRIME1;
+		h = ((h << 27) | (h >> 37)) * PRIME1 + PRIME4;
+	}
+	for (; i < numBytes; i++) {
+		h ^= bytes[i] * PRIME3;
+		h = ((h << 11) | (h >> 53)) * PRIME1;
+	}
+	h ^= h >> 33;
+	h *= PRIME2;
+	h ^= h >> 29;
+	h *= PRIME3;
+	h ^= h >> 32;
+	return h;
+}
+
 //Keep Watchdog - Keep the big panel off until all panels are solved
 
 void KeepWatchdog::action() {
@@ -48,157 +469,215 @@ void ArrowWatchdog::action() {
 	if (length == tracedLength) return;
 	initPath();
 	if (complete) {
-		for (int x = 1; x < width; x++) {
-			for (int y = 1; y < height; y++) {
-				if (!checkArrow(x, y)) {
-					//OutputDebugStringW(L"No");
-					WritePanelData<int>(id, STYLE_FLAGS, { style | Panel::Style::HAS_TRIANGLES });
-					return;
-				}
-			}
+		if (failing > 0) {
+			//OutputDebugStringW(L"No");
+			WritePanelData<int>(id, STYLE_FLAGS, { style | Panel::Style::HAS_TRIANGLES });
+			return;
 		}
 		//OutputDebugStringW(L"Yes");
 		WritePanelData<int>(id, STYLE_FLAGS, { style & ~Panel::Style::HAS_TRIANGLES });
 	}
 }
 
+void ArrowWatchdog::init(int pillarWidth)
+{
+	this->pillarWidth = pillarWidth;
+	width = static_cast<int>(backupGrid.size());
+	height = static_cast<int>(backupGrid[0].size());
+	tracedLength = 0;
+	complete = tracedComplete = false;
+	DIRECTIONS = { Point(0, 2), Point(0, -2), Point(2, 0), Point(-2, 0), Point(2, 2), Point(2, -2), Point(-2, -2), Point(-2, 2) };
+	exitPosSym = (width / 2 + 1) * (height / 2 + 1) - 1 - exitPos;
+	exitPoint = pillarWidth > 0 ? (width / 2) * (height / 2 + 1) : (width / 2 + 1) * (height / 2 + 1);
+	initChecks();
+}
+
+//Work out which edges are on the grid now, and mark/unmark only the ones that differ from last time
 void ArrowWatchdog::initPath()
 {
 	int numTraced = ReadPanelData<int>(id, TRACED_EDGES);
 	int tracedptr = ReadPanelData<int>(id, TRACED_EDGE_DATA);
 	if (!tracedptr) return;
-	std::vector<SolutionPoint> traced = ReadArray<SolutionPoint>(id, TRACED_EDGE_DATA, numTraced);
-	if (style & Panel::Style::SYMMETRICAL) {
-		for (int i = 0; i < numTraced; i++) {
-			SolutionPoint sp;
-			if (traced[i].pointA >= exitPoint || traced[i].pointB >= exitPoint) {
-				sp.pointA = sp.pointB = exitPoint;
-			}
-			else {
-				sp.pointA = (width / 2 + 1) * (height / 2 + 1) - 1 - traced[i].pointA;
-				sp.pointB = (width / 2 + 1) * (height / 2 + 1) - 1 - traced[i].pointB;
-			}
-			traced.push_back(sp);
-		}
+	std::vector<SolutionPoint> traced;
+	if (!ReadArrayIfChanged(id, TRACED_EDGE_DATA, numTraced, tracedHash, traced)) {
+		//Same path as last time, so the marks on the grid are already right
+		tracedLength = numTraced;
+		complete = tracedComplete;
+		return;
 	}
-	grid = backupGrid;
 	tracedLength = numTraced;
 	complete = false;
-	if (traced.size() == 0) return;
-	for (const SolutionPoint& p : traced) {
-		int p1 = p.pointA, p2 = p.pointB;
-		if (p1 == exitPoint || p2 == exitPoint) {
-			complete = true;
-			continue;
-		}
-		else if (p1 > exitPoint || p2 > exitPoint) continue;
-		if (p1 == 0 && p2 == 0 || p1 < 0 || p2 < 0) {
-			return;
-		}
-		int x1 = (p1 % (width / 2 + 1)) * 2, y1 = height - 1 - (p1 / (width / 2 + 1)) * 2;
-		int x2 = (p2 % (width / 2 + 1)) * 2, y2 = height - 1 - (p2 / (width / 2 + 1)) * 2;
-		if (pillarWidth > 0) {
-			x1 = (p1 % (width / 2)) * 2, y1 = height - 1 - (p1 / (width / 2)) * 2;
-			x2 = (p2 % (width / 2)) * 2, y2 = height - 1 - (p2 / (width / 2)) * 2;
-			grid[x1][y1] = PATH;
-			grid[x2][y2] = PATH;
-			if (x1 == x2 || x1 == x2 + 2 || x1 == x2 - 2) grid[(x1 + x2) / 2][(y1 + y2) / 2] = PATH;
-			else grid[width - 1][(y1 + y2) / 2] = PATH;
-		}
-		else {
-			grid[x1][y1] = PATH;
-			grid[x2][y2] = PATH;
-			grid[(x1 + x2) / 2][(y1 + y2) / 2] = PATH;
-		}
-		if (p1 == exitPos || p2 == exitPos || (style & Panel::Style::SYMMETRICAL) && (p1 == exitPosSym || p2 == exitPosSym)) {
-			complete = !complete;
+	//The mirror image of the path is processed after the whole path, same as if it had been appended to it
+	std::vector<std::pair<int, int>> edges, symEdges;
+	bool stopped = false;
+	for (int pass = 0; pass < ((style & Panel::Style::SYMMETRICAL) ? 2 : 1) && !stopped; pass++) {
+		for (const SolutionPoint& sp : traced) {
+			int p1 = sp.pointA, p2 = sp.pointB;
+			if (pass == 1) {
+				if (p1 >= exitPoint || p2 >= exitPoint) p1 = p2 = exitPoint;
+				else {
+					p1 = (width / 2 + 1) * (height / 2 + 1) - 1 - p1;
+					p2 = (width / 2 + 1) * (height / 2 + 1) - 1 - p2;
+				}
+			}
+			if (p1 == exitPoint || p2 == exitPoint) {
+				complete = true;
+				continue;
+			}
+			else if (p1 > exitPoint || p2 > exitPoint) continue;
+			if (p1 == 0 && p2 == 0 || p1 < 0 || p2 < 0) {
+				stopped = true;
+				break;
+			}
+			(pass == 0 ? edges : symEdges).emplace_back(p1, p2);
+			if (p1 == exitPos || p2 == exitPos || (style & Panel::Style::SYMMETRICAL) && (p1 == exitPosSym || p2 == exitPosSym)) {
+				complete = !complete;
+			}
+			else complete = false;
 		}
-		else complete = false;
 	}
+	updateEdges(appliedEdges, edges);
+	updateEdges(appliedSymEdges, symEdges);
+	tracedComplete = complete;
 }
 
-bool ArrowWatchdog::checkArrow(int x, int y)
+//Unmark the applied edges past the point where they stop matching, then mark the new ones
+void ArrowWatchdog::updateEdges(std::vector<std::pair<int, int>>& applied, const std::vector<std::pair<int, int>>& edges)
 {
-	if (pillarWidth > 0) return checkArrowPillar(x, y);
-	int symbol = grid[x][y];
-	if ((symbol & 0x700) == Decoration::Triangle && (symbol & 0xf0000) != 0) {
-		int count = 0;
-		if (grid[x - 1][y] == PATH) count++;
-		if (grid[x + 1][y] == PATH) count++;
-		if (grid[x][y - 1] == PATH) count++;
-		if (grid[x][y + 1] == PATH) count++;
-		return count == (symbol >> 16);
+	size_t common = 0;
+	while (common < applied.size() && common < edges.size() && applied[common] == edges[common]) common++;
+	while (applied.size() > common) {
+		markEdge(applied.back(), -1);
+		applied.pop_back();
 	}
-	if ((symbol & 0x700) != Decoration::Arrow)
-		return true;
-	int targetCount = (symbol & 0xf000) >> 12;
-	Point dir = DIRECTIONS[(symbol & 0xf0000) >> 16];
-	x += dir.first / 2; y += dir.second / 2;
-	int count = 0;
-	while (x >= 0 && x < width && y >= 0 && y < height) {
-		if (grid[x][y] == PATH) {
-			if (++count > targetCount)
-				return false;
-		}
-		x += dir.first; y += dir.second;
+	for (size_t i = common; i < edges.size(); i++) {
+		markEdge(edges[i], 1);
+		applied.push_back(edges[i]);
 	}
-	return count == targetCount;
 }
 
-bool ArrowWatchdog::checkArrowPillar(int x, int y)
+void ArrowWatchdog::markEdge(const std::pair<int, int>& edge, int delta)
 {
-	int symbol = grid[x][y];
-	if ((symbol & 0x700) == Decoration::Triangle && (symbol & 0xf0000) != 0) {
-		int count = 0;
-		if (grid[x - 1][y] == PATH) count++;
-		if (grid[x + 1][y] == PATH) count++;
-		if (grid[x][y - 1] == PATH) count++;
-		if (grid[x][y + 1] == PATH) count++;
-		return count == (symbol >> 16);
+	int p1 = edge.first, p2 = edge.second;
+	if (pillarWidth > 0) {
+		int x1 = (p1 % (width / 2)) * 2, y1 = height - 1 - (p1 / (width / 2)) * 2;
+		int x2 = (p2 % (width / 2)) * 2, y2 = height - 1 - (p2 / (width / 2)) * 2;
+		markCell(x1, y1, delta);
+		markCell(x2, y2, delta);
+		if (x1 == x2 || x1 == x2 + 2 || x1 == x2 - 2) markCell((x1 + x2) / 2, (y1 + y2) / 2, delta);
+		else markCell(width - 1, (y1 + y2) / 2, delta);
 	}
-	if ((symbol & 0x700) != Decoration::Arrow)
-		return true;
-	int targetCount = (symbol & 0xf000) >> 12;
-	Point dir = DIRECTIONS[(symbol & 0xf0000) >> 16];
-	x = (x + (dir.first > 2 ? -2 : dir.first) / 2 + pillarWidth) % pillarWidth; y += dir.second / 2;
-	int count = 0;
-	while (y >= 0 && y < height) {
-		if (grid[x][y] == PATH) {
-			if (++count > targetCount) return false;
+	else {
+		int x1 = (p1 % (width / 2 + 1)) * 2, y1 = height - 1 - (p1 / (width / 2 + 1)) * 2;
+		int x2 = (p2 % (width / 2 + 1)) * 2, y2 = height - 1 - (p2 / (width / 2 + 1)) * 2;
+		markCell(x1, y1, delta);
+		markCell(x2, y2, delta);
+		markCell((x1 + x2) / 2, (y1 + y2) / 2, delta);
+	}
+}
+
+void ArrowWatchdog::markCell(int x, int y, int delta)
+{
+	if (x < 0 || x >= width || y < 0 || y >= height) return;
+	int cell = x * height + y;
+	bool wasPath = pathCount[cell] > 0 || backupGrid[x][y] == PATH;
+	pathCount[cell] += delta;
+	bool isPath = pathCount[cell] > 0 || backupGrid[x][y] == PATH;
+	if (wasPath == isPath) return;
+	for (int index : cellChecks[cell]) {
+		Check& check = checks[index];
+		bool wasOk = check.crossings == check.target;
+		check.crossings += isPath ? 1 : -1;
+		bool isOk = check.crossings == check.target;
+		if (wasOk && !isOk) failing++;
+		if (!wasOk && isOk) failing--;
+	}
+}
+
+//Find the cells each arrow counts along its ray, and the cells around each triangle
+void ArrowWatchdog::initChecks()
+{
+	checks.clear();
+	cellChecks = std::vector<std::vector<int>>(width * height);
+	pathCount = std::vector<int>(width * height, 0);
+	appliedEdges.clear();
+	appliedSymEdges.clear();
+	failing = 0;
+	for (int x = 1; x < width; x++) {
+		for (int y = 1; y < height; y++) {
+			int symbol = backupGrid[x][y];
+			Check check;
+			if ((symbol & 0x700) == Decoration::Triangle && (symbol & 0xf0000) != 0) {
+				check.target = symbol >> 16;
+				for (std::pair<int, int> p : { std::make_pair(x - 1, y), std::make_pair(x + 1, y), std::make_pair(x, y - 1), std::make_pair(x, y + 1) }) {
+					if (pillarWidth > 0) p.first = (p.first + pillarWidth) % pillarWidth; //The last column of a pillar is next to the first
+					if (p.first >= 0 && p.first < width && p.second >= 0 && p.second < height) check.cells.push_back(p.first * height + p.second);
+				}
+			}
+			else if ((symbol & 0x700) == Decoration::Arrow) {
+				check.target = (symbol & 0xf000) >> 12;
+				Point dir = DIRECTIONS[(symbol & 0xf0000) >> 16];
+				int cx = x, cy = y;
+				std::set<int> seen; //A sideways ray on a pillar wraps around, so stop once it comes back
+				if (pillarWidth > 0) cx = (cx + (dir.first > 2 ? -2 : dir.first) / 2 + pillarWidth) % pillarWidth;
+				else cx += dir.first / 2;
+				cy += dir.second / 2;
+				while (cx >= 0 && cx < width && cy >= 0 && cy < height && seen.insert(cx * height + cy).second) {
+					check.cells.push_back(cx * height + cy);
+					if (pillarWidth > 0) cx = (cx + dir.first + pillarWidth) % pillarWidth;
+					else cx += dir.first;
+					cy += dir.second;
+				}
+			}
+			else continue;
+			check.crossings = 0;
+			for (int cell : check.cells) {
+				if (backupGrid[cell / height][cell % height] == PATH) check.crossings++;
+				cellChecks[cell].push_back(static_cast<int>(checks.size()));
+			}
+			if (check.crossings != check.target) failing++;
+			checks.push_back(check);
 		}
-		x = (x + dir.first + pillarWidth) % pillarWidth; y += dir.second;
 	}
-	return count == targetCount;
 }
 
 void BridgeWatchdog::action()
 {
-	int length1 = _memory->ReadPanelData<int>(id1, TRACED_EDGES);
-	int length2 = _memory->ReadPanelData<int>(id2, TRACED_EDGES);
+	int length1 = ReadPanelData<int>(id1, TRACED_EDGES);
+	int length2 = ReadPanelData<int>(id2, TRACED_EDGES);
 	if (solLength1 > 0 && length1 == 0) {
-		_memory->WritePanelData<int>(id2, STYLE_FLAGS, { _memory->ReadPanelData<int>(id2, STYLE_FLAGS) | Panel::Style::HAS_DOTS });
+		WritePanelData<int>(id2, STYLE_FLAGS, { ReadPanelData<int>(id2, STYLE_FLAGS) | Panel::Style::HAS_DOTS });
 	}
 	if (solLength2 > 0 && length2 == 0) {
-		_memory->WritePanelData<int>(id1, STYLE_FLAGS, { _memory->ReadPanelData<int>(id1, STYLE_FLAGS) | Panel::Style::HAS_DOTS });
+		WritePanelData<int>(id1, STYLE_FLAGS, { ReadPanelData<int>(id1, STYLE_FLAGS) | Panel::Style::HAS_DOTS });
 	}
 	if (length1 != solLength1 && length1 > 0 && !checkTouch(id2)) {
-		_memory->WritePanelData<int>(id2, STYLE_FLAGS, { _memory->ReadPanelData<int>(id2, STYLE_FLAGS) & ~Panel::Style::HAS_DOTS });
+		WritePanelData<int>(id2, STYLE_FLAGS, { ReadPanelData<int>(id2, STYLE_FLAGS) & ~Panel::Style::HAS_DOTS });
 	}
 	if (length2 != solLength2 && length2 > 0 && !checkTouch(id1)) {
-		_memory->WritePanelData<int>(id1, STYLE_FLAGS, { _memory->ReadPanelData<int>(id1, STYLE_FLAGS) & ~Panel::Style::HAS_DOTS });
+		WritePanelData<int>(id1, STYLE_FLAGS, { ReadPanelData<int>(id1, STYLE_FLAGS) & ~Panel::Style::HAS_DOTS });
 	}
+	if (length1 != solLength1 || length2 != solLength2) stateChanged();
 	solLength1 = length1;
 	solLength2 = length2;
 }
 
 bool BridgeWatchdog::checkTouch(int id)
 {
-	int length = _memory->ReadPanelData<int>(id, TRACED_EDGES);
+	int length = ReadPanelData<int>(id, TRACED_EDGES);
 	if (length == 0) return false;
-	int numIntersections = _memory->ReadPanelData<int>(id, NUM_DOTS);
-	std::vector<int> intersectionFlags = _memory->ReadArray<int>(id, DOT_FLAGS, numIntersections);
-	std::vector<SolutionPoint> edges = _memory->ReadArray<SolutionPoint>(id, TRACED_EDGE_DATA, length);
-	for (const SolutionPoint& sp : edges) if (intersectionFlags[sp.pointA] == Decoration::Dot_Intersection || intersectionFlags[sp.pointB] == Decoration::Dot_Intersection) return true;
+	int numIntersections = ReadPanelData<int>(id, NUM_DOTS);
+	std::vector<int> intersectionFlags;
+	if (ReadArrayIfChanged(id, DOT_FLAGS, numIntersections, dotFlagsHash[id], intersectionFlags)) {
+		std::vector<bool>& dots = isDot[id];
+		dots.resize(intersectionFlags.size());
+		for (size_t i = 0; i < intersectionFlags.size(); i++) dots[i] = (intersectionFlags[i] == Decoration::Dot_Intersection);
+	}
+	const std::vector<bool>& dots = isDot[id];
+	std::vector<SolutionPoint> edges = ReadArray<SolutionPoint>(id, TRACED_EDGE_DATA, length);
+	for (const SolutionPoint& sp : edges) {
+		if ((sp.pointA >= 0 && static_cast<size_t>(sp.pointA) < dots.size() && dots[sp.pointA]) || (sp.pointB >= 0 && static_cast<size_t>(sp.pointB) < dots.size() && dots[sp.pointB])) return true;
+	}
 	return false;
 }
 
@@ -213,10 +692,15 @@ void TreehouseWatchdog::action()
 
 void JungleWatchdog::action()
 {
-	int numTraced = ReadPanelData<int>(id, TRACED_EDGES);
-	if (numTraced == tracedLength) return;
+	//The count and pointer come from the snapshot. If neither has changed, the count can't have either, so this is just a hash compare while nothing is being traced.
+	std::vector<byte> header;
+	if (!ReadRegionIfChanged(id, TRACED_EDGES, TRACED_REGION_SIZE, headerHash, header)) return;
+	int numTraced;
+	uintptr_t tracedptr;
+	memcpy(&numTraced, &header[0], sizeof(int));
+	memcpy(&tracedptr, &header[TRACED_EDGE_DATA - TRACED_EDGES], sizeof(uintptr_t));
+	if (numTraced == tracedLength) return; //Only a new length gets the sequence checked, even if the line was retraced
 	tracedLength = numTraced;
-	int tracedptr = ReadPanelData<int>(id, TRACED_EDGE_DATA);
 	if (!tracedptr) return;
 	std::vector<SolutionPoint> traced = ReadArray<SolutionPoint>(id, TRACED_EDGE_DATA, numTraced);
 	int seqIndex = 0;
@@ -231,6 +715,7 @@ void JungleWatchdog::action()
 			WritePanelData<int>(id, DOT_SEQUENCE_LEN, { state ? (int)correctSeq1.size() : (int)correctSeq2.size() });
 			WritePanelData<int>(id, DOT_SEQUENCE_LEN_REFLECTION, { state ? (int)correctSeq2.size() : (int)correctSeq1.size() });
 			state = !state;
+			stateChanged();
 			return;
 		}
 	}
@@ -3,6 +3,130 @@
 #include "Panel.h"
 #include "Randomizer.h"
 #include "Generate.h"
+#include "Quaternion.h"
+#include "WatchdogStats.h"
+#include "WatchdogRegistry.h"
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <queue>
+#include <chrono>
+#include <atomic>
+#include <set>
+#include <cstring>
+
+class Watchdog;
+
+//Panel fields read once for all the watchdogs that are due on a scheduler tick. Immutable once published.
+struct GameSnapshot {
+	std::map<std::pair<int, int>, std::vector<byte>> fields; //(panel, offset) -> bytes
+
+	template <class T> bool get(int panel, int offset, T& value) const {
+		return get(panel, offset, &value, sizeof(T));
+	}
+
+	bool get(int panel, int offset, void* buffer, size_t numBytes) const {
+		auto search = fields.find(std::make_pair(panel, offset));
+		if (search == fields.end() || search->second.size() < numBytes) return false;
+		memcpy(buffer, &search->second[0], numBytes);
+		return true;
+	}
+};
+
+//Remembers a hash of the bytes a watchdog last processed, so content it has already seen doesn't get decoded and processed again
+class ChangeDetector {
+public:
+	//Returns true if the bytes hash differently from the last call (always true the first time)
+	bool changed(const void* data, size_t numBytes) {
+		uint64_t value = hash(data, numBytes);
+		if (_valid && value == _hash) return false;
+		_hash = value;
+		_valid = true;
+		return true;
+	}
+	void reset() { _valid = false; }
+
+	static uint64_t hash(const void* data, size_t numBytes); //xxHash style 64 bit hash. Not stable across versions - only meant for comparing within a run.
+
+private:
+	uint64_t _hash = 0;
+	bool _valid = false;
+};
+
+//From the traced edge count to the end of the traced edge pointer, so both can be read (and hashed) together
+const int TRACED_REGION_SIZE = TRACED_EDGE_DATA + sizeof(uintptr_t) - TRACED_EDGES;
+
+struct WatchedField {
+	int panel, offset, size;
+};
+
+//Bounds for adaptive polling, in seconds
+struct PollBounds {
+	float minInterval = 0.01f; //No watchdog runs more often than this
+	float activeInterval = 0.05f; //Watchdogs of a panel that is being traced run at least this often
+	float probeInterval = 0.1f; //How often idle panels are checked for a new trace. Watchdogs that don't follow a traced line are woken on the same ticks.
+	float heartbeat = 2.0f; //Watchdogs of idle panels still run this often
+	float activeHold = 2.0f; //A panel counts as being traced for this long after its traced line last changed
+};
+
+//Runs every watchdog on a single thread, sleeping until the earliest one is due.
+//Watchdogs that follow a traced line (see activityPanels) run fast while the player is tracing one of their panels, and drop to a heartbeat otherwise.
+//Idle panels are probed together for a new trace, which promotes their watchdogs straight away. Everything that isn't urgent is lined up on the probe ticks so it shares wakeups.
+//All watchdogs share one Memory instance, which is only used while holding memoryMutex.
+class WatchdogScheduler
+{
+public:
+	static void add(Watchdog* watchdog); //Takes ownership. The watchdog is deleted once it terminates or is cancelled.
+	static void cancel(Watchdog* watchdog);
+	static void stop(); //Save the running watchdogs to the registry, then cancel them all and join the scheduler thread
+	static void cancelAll();
+	static int restore(); //Start the watchdogs saved in the registry, if it was saved for this game process. Returns how many were started.
+	static std::shared_ptr<Memory> getMemory();
+	static std::shared_ptr<const GameSnapshot> latestSnapshot() { return std::atomic_load(&_snapshot); }
+	static void setPollBounds(const PollBounds& bounds);
+	static PollBounds getPollBounds();
+
+	static std::recursive_mutex memoryMutex;
+
+private:
+	typedef std::chrono::steady_clock::time_point TimePoint;
+
+	static void run();
+	static std::shared_ptr<const GameSnapshot> poll(const std::vector<Watchdog*>& watchdogs);
+	static std::shared_ptr<GameSnapshot> readFields(const std::map<std::pair<int, int>, int>& wanted, TimePoint now);
+	static std::vector<Watchdog*> probe(TimePoint now);
+	static void reschedule(Watchdog* watchdog, TimePoint now, const PollBounds& bounds);
+	static void schedule(Watchdog* watchdog, TimePoint due);
+	static void release(Watchdog* watchdog);
+	static bool isActive(Watchdog* watchdog, TimePoint now, const PollBounds& bounds);
+	static void recordStats(Watchdog* watchdog);
+	static TimePoint alignToTick(TimePoint time, const PollBounds& bounds);
+	static std::vector<WatchdogRegistry::Item> registryItems();
+
+	typedef std::pair<TimePoint, Watchdog*> Entry;
+	static std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> _queue;
+	static std::shared_ptr<Memory> _memory;
+	static std::shared_ptr<const GameSnapshot> _snapshot;
+	static std::mutex _mutex;
+	static std::condition_variable _wake;
+	static std::thread _thread;
+	static bool _stopping;
+	static PollBounds _bounds;
+	static TimePoint _nextProbe;
+	static std::set<Watchdog*> _live; //Every watchdog the scheduler owns that hasn't been deleted
+	static WatchdogRegistry::Key _registryKey;
+	static bool _registryDirty;
+	static TimePoint _nextSave;
+	//Only used on the scheduler thread
+	static std::set<Watchdog*> _idle; //Watchdogs on the heartbeat, waiting for one of their panels to be traced
+	struct TracedLine {
+		int length; //Last seen
+		TimePoint changed; //When a read first saw the current length
+		TimePoint before; //The read before that, which still saw the old length
+		TimePoint lastRead;
+	};
+	static std::map<int, TracedLine> _traced;
+};
 
 class Watchdog
 {
@@ -10,72 +134,170 @@ public:
 	Watchdog(float time) {
 		terminate = false;
 		sleepTime = time;
-		_memory = std::make_shared<Memory>("witness64_d3d11.exe");
+		_memory = WatchdogScheduler::getMemory();
 	};
+	virtual ~Watchdog() { }
 	void start();
-	void run();
 	virtual void action() = 0;
+	//Fields this watchdog reads every time it runs. The scheduler polls these together for every due watchdog, and reads of them inside action() come from that snapshot.
+	virtual std::vector<WatchedField> watchedFields() { return {}; }
+	//Panels whose traced line this watchdog follows. Their TRACED_EDGES must be among the watched fields. Watchdogs with none run every sleepTime.
+	virtual std::vector<int> activityPanels() { return {}; }
 	float sleepTime;
-	bool terminate;
+	std::atomic<bool> terminate; //Set by the watchdog itself or by cancel() on another thread
+
+	enum Type { Keep, Arrow, Bridge, Treehouse, Jungle, TownDoor };
+	//Type followed by the constructor arguments. Enough to start the same watchdog again when a cached randomization is replayed.
+	virtual std::vector<int> getRecord() = 0;
+	static Watchdog* fromRecord(const std::vector<int>& record);
+	//Whatever the watchdog has worked out or changed in the game since it started, for the registry. Only valid for the same game process.
+	virtual std::vector<int> getState() { return {}; }
+	virtual bool setState(const std::vector<int>& state) { return state.size() == 0; }
+	static Watchdog* fromState(const std::vector<int>& record, const std::vector<int>& state);
+	//Watchdogs started between these two calls are recorded
+	static void startRecording();
+	static std::vector<std::vector<int>> stopRecording();
+
+private:
+	static bool _recording;
+	static std::vector<std::vector<int>> _records;
+	static std::mutex _recordMutex;
 protected:
 	template <class T> std::vector<T> ReadPanelData(int panel, int offset, size_t size) {
+		if (_snapshot && size > 0 && !_written.count(std::make_pair(panel, offset))) {
+			std::vector<T> data(size);
+			if (_snapshot->get(panel, offset, &data[0], sizeof(T) * size)) return data;
+		}
+		_readBytes += sizeof(T) * size;
+		std::lock_guard<std::recursive_mutex> lock(WatchdogScheduler::memoryMutex);
 		return _memory->ReadPanelData<T>(panel, offset, size);
 	}
 	template <class T> T ReadPanelData(int panel, int offset) {
+		T value;
+		if (_snapshot && !_written.count(std::make_pair(panel, offset)) && _snapshot->get(panel, offset, value)) return value;
+		_readBytes += sizeof(T);
+		std::lock_guard<std::recursive_mutex> lock(WatchdogScheduler::memoryMutex);
 		return _memory->ReadPanelData<T>(panel, offset);
 	}
 	template <class T> std::vector<T> ReadArray(int panel, int offset, int size) {
+		_readBytes += sizeof(T) * size;
+		std::lock_guard<std::recursive_mutex> lock(WatchdogScheduler::memoryMutex);
 		return _memory->ReadArray<T>(panel, offset, size);
 	}
 	template <class T> void WritePanelData(int panel, int offset, const std::vector<T>& data) {
-		return _memory->WritePanelData<T>(panel, offset, data);
+		_written.insert(std::make_pair(panel, offset)); //Read it back from the game, not the snapshot, for the rest of this action
+		std::lock_guard<std::recursive_mutex> lock(WatchdogScheduler::memoryMutex);
+		_memory->WritePanelData<T>(panel, offset, data);
+		_lastWrite = std::chrono::steady_clock::now();
 	}
 	template <class T> void WriteArray(int panel, int offset, const std::vector<T>& data) {
-		return _memory->WriteArray<T>(panel, offset, data, false);
+		WriteArray(panel, offset, data, false);
 	}
 	template <class T> void WriteArray(int panel, int offset, const std::vector<T>& data, bool force) {
-		return _memory->WriteArray<T>(panel, offset, data, force);
+		std::lock_guard<std::recursive_mutex> lock(WatchdogScheduler::memoryMutex);
+		_memory->WriteArray<T>(panel, offset, data, force);
+		_lastWrite = std::chrono::steady_clock::now();
+	}
+	//Read a range of a panel's fields in one go. Returns false (and leaves bytes alone) if it hashes the same as last time for this detector.
+	bool ReadRegionIfChanged(int panel, int offset, int numBytes, ChangeDetector& detector, std::vector<byte>& bytes) {
+		std::vector<byte> data = ReadPanelData<byte>(panel, offset, numBytes);
+		if (!detector.changed(data.data(), data.size())) return false;
+		bytes.swap(data);
+		return true;
 	}
+	//Read an array, and only hand it out if it hashes differently from the last one this detector saw
+	template <class T> bool ReadArrayIfChanged(int panel, int offset, int size, ChangeDetector& detector, std::vector<T>& items) {
+		std::vector<T> data = ReadArray<T>(panel, offset, size);
+		if (!detector.changed(data.data(), sizeof(T) * data.size())) return false;
+		items.swap(data);
+		return true;
+	}
+	void stateChanged() { _stateChanged = true; } //Get the registry saved again soon
 	std::shared_ptr<Memory> _memory;
+	std::shared_ptr<const GameSnapshot> _snapshot; //Set by the scheduler for the duration of action()
+	std::set<std::pair<int, int>> _written;
+	std::chrono::steady_clock::time_point _due; //Queue entries for any other time have been superseded
+	int _queued = 0; //Queue entries still referring to this watchdog
+	bool _stateChanged = false;
+	//For WatchdogStats
+	int _type = -1;
+	size_t _readBytes = 0; //Read directly during the current action
+	std::chrono::steady_clock::time_point _lastWrite; //End of the last write during the current action
+	std::chrono::steady_clock::time_point _responded; //Latest traced line change that has been answered with a write
+
+	friend class WatchdogScheduler;
 };
 
 class KeepWatchdog : public Watchdog {
 public:
 	KeepWatchdog() : Watchdog(10) { }
 	virtual void action();
+	virtual std::vector<int> getRecord() { return { Type::Keep }; }
+	virtual std::vector<WatchedField> watchedFields() { return { { 0x01BE9, SOLVED, sizeof(int) } }; }
 };
 
 class ArrowWatchdog : public Watchdog {
 public:
-	ArrowWatchdog(int id) : Watchdog(0.1f) {
+	ArrowWatchdog(int id) : ArrowWatchdog(id, 0) { }
+	ArrowWatchdog(int id, int pillarWidth) : Watchdog(0.1f) {
 		Panel panel(id);
 		this->id = id;
-		grid = backupGrid = panel._grid;
-		width = static_cast<int>(grid.size());
-		height = static_cast<int>(grid[0].size());
-		pillarWidth = tracedLength = 0;
-		complete = false;
+		backupGrid = panel._grid;
 		style = ReadPanelData<int>(id, STYLE_FLAGS);
-		DIRECTIONS = { Point(0, 2), Point(0, -2), Point(2, 0), Point(-2, 0), Point(2, 2), Point(2, -2), Point(-2, -2), Point(-2, 2) };
 		exitPos = panel.xy_to_loc(panel._endpoints[0].GetX(), panel._endpoints[0].GetY());
-		exitPosSym = (width / 2 + 1) * (height / 2 + 1) - 1 - exitPos;
-		exitPoint = (width / 2 + 1) * (height / 2 + 1);
+		cylinderWidth = Point::pillarWidth; //Set by reading the panel
+		init(pillarWidth);
 	}
-	ArrowWatchdog(int id, int pillarWidth) : ArrowWatchdog(id) {
-		this->pillarWidth = pillarWidth;
-		if (pillarWidth > 0) exitPoint = (width / 2) * (height / 2 + 1);
+	//From getState, without reading the panel from the game. The state has to be checked with validState first.
+	ArrowWatchdog(int id, int pillarWidth, const std::vector<int>& state) : Watchdog(0.1f) {
+		this->id = id;
+		style = state[0];
+		exitPos = state[1];
+		cylinderWidth = state[2];
+		backupGrid.resize(state[3]);
+		for (int x = 0; x < state[3]; x++) backupGrid[x].assign(state.begin() + 5 + x * state[4], state.begin() + 5 + (x + 1) * state[4]);
+		Point::pillarWidth = cylinderWidth; //Same as reading the panel would have left it
+		init(pillarWidth);
 	}
 	virtual void action();
+	virtual std::vector<int> getRecord() { return { Type::Arrow, id, pillarWidth }; }
+	virtual std::vector<int> getState() {
+		std::vector<int> state = { style, exitPos, cylinderWidth, width, height };
+		for (const std::vector<int>& column : backupGrid) state.insert(state.end(), column.begin(), column.end());
+		return state;
+	}
+	static bool validState(const std::vector<int>& state) {
+		return state.size() >= 5 && state[3] > 0 && state[4] > 0 && state.size() == 5 + static_cast<size_t>(state[3]) * state[4];
+	}
+	void init(int pillarWidth);
+	virtual std::vector<WatchedField> watchedFields() { return { { id, TRACED_EDGES, sizeof(int) } }; }
+	virtual std::vector<int> activityPanels() { return { id }; }
 	void initPath();
-	bool checkArrow(int x, int y);
-	bool checkArrowPillar(int x, int y);
+	void initChecks();
+	void updateEdges(std::vector<std::pair<int, int>>& applied, const std::vector<std::pair<int, int>>& edges);
+	void markEdge(const std::pair<int, int>& edge, int delta);
+	void markCell(int x, int y, int delta);
+
+	//One arrow or triangle. crossings is the number of its cells that are on the path, kept up to date as edges are added and removed.
+	struct Check {
+		std::vector<int> cells;
+		int target;
+		int crossings;
+	};
 
 	int id;
 	std::vector<std::vector<int>> backupGrid;
-	std::vector<std::vector<int>> grid;
+	std::vector<Check> checks;
+	std::vector<std::vector<int>> cellChecks; //Cell index -> checks that look at that cell
+	std::vector<int> pathCount; //Cell index -> number of applied edges covering it
+	std::vector<std::pair<int, int>> appliedEdges, appliedSymEdges; //Traced edges (and their mirror images) currently marked on the grid
+	int failing; //Number of checks whose crossings don't match their target
 	int width, height, pillarWidth;
+	int cylinderWidth; //Point::pillarWidth for this panel's grid
 	int tracedLength;
 	bool complete;
+	bool tracedComplete; //complete as of the last path that was processed
+	ChangeDetector tracedHash;
 	int style;
 	int exitPos, exitPosSym, exitPoint;
 	std::vector<Point> DIRECTIONS;
@@ -89,14 +311,31 @@ public:
 		this->id1 = id1; this->id2 = id2;
 	}
 	virtual void action();
+	virtual std::vector<int> getRecord() { return { Type::Bridge, id1, id2 }; }
+	virtual std::vector<int> getState() { return { solLength1, solLength2 }; }
+	virtual bool setState(const std::vector<int>& state) {
+		if (state.size() != 2) return false;
+		solLength1 = state[0];
+		solLength2 = state[1];
+		return true;
+	}
+	virtual std::vector<WatchedField> watchedFields() {
+		return { { id1, TRACED_EDGES, sizeof(int) }, { id2, TRACED_EDGES, sizeof(int) }, { id1, STYLE_FLAGS, sizeof(int) }, { id2, STYLE_FLAGS, sizeof(int) } };
+	}
+	virtual std::vector<int> activityPanels() { return { id1, id2 }; }
 	bool checkTouch(int id);
 	int id1, id2, solLength1, solLength2;
+	std::map<int, ChangeDetector> dotFlagsHash;
+	std::map<int, std::vector<bool>> isDot; //Panel -> intersection -> whether it has a dot, decoded from DOT_FLAGS
 };
 
 class TreehouseWatchdog : public Watchdog {
 public:
-	TreehouseWatchdog(int id) : Watchdog(1) { }
+	TreehouseWatchdog(int id) : Watchdog(1) { this->id = id; }
 	virtual void action();
+	virtual std::vector<int> getRecord() { return { Type::Treehouse, id }; }
+	virtual std::vector<WatchedField> watchedFields() { return { { 0x03613, SOLVED, sizeof(int) } }; }
+	int id;
 };
 
 class JungleWatchdog : public Watchdog {
@@ -113,16 +352,35 @@ public:
 		ptr2 = ReadPanelData<long>(id, DOT_SEQUENCE_REFLECTION);
 	}
 	virtual void action();
+	virtual std::vector<int> getRecord() {
+		std::vector<int> record = { Type::Jungle, id, static_cast<int>(correctSeq1.size()) };
+		record.insert(record.end(), correctSeq1.begin(), correctSeq1.end());
+		record.insert(record.end(), correctSeq2.begin(), correctSeq2.end());
+		return record;
+	}
+	//Only which way round the sequences are. The pointers are game heap addresses, so they are always read from the panel.
+	virtual std::vector<int> getState() { return { state }; }
+	virtual bool setState(const std::vector<int>& state) {
+		if (state.size() != 1) return false;
+		this->state = (state[0] != 0);
+		if (this->state) std::swap(ptr1, ptr2); //The constructor read them after they were swapped in the game
+		return true;
+	}
+	virtual std::vector<WatchedField> watchedFields() { return { { id, TRACED_EDGES, TRACED_REGION_SIZE } }; }
+	virtual std::vector<int> activityPanels() { return { id }; }
 	int id;
 	std::vector<int> sizes;
 	long ptr1, ptr2;
 	std::vector<int> correctSeq1, correctSeq2;
 	bool state;
 	int tracedLength;
+	ChangeDetector headerHash;
 };
 
 class TownDoorWatchdog : public Watchdog {
 public:
 	TownDoorWatchdog() : Watchdog(0.2f) { }
 	virtual void action();
+	virtual std::vector<int> getRecord() { return { Type::TownDoor }; }
+	virtual std::vector<WatchedField> watchedFields() { return { { 0x03BB0, ORIENTATION, sizeof(Quaternion) } }; }
 };
\ No newline at end of file
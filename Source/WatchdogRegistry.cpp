@@ -0,0 +1,59 @@
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+
+// PVS-Studio Static Code Analyzer for C, C++, C#, and Java: http://www.viva64.com
+
+#include "WatchdogRegistry.h"
+#include "BinaryFile.h"
+#include <cstdio>
+
+const char* WatchdogRegistry::FILENAME = "WRPGwatchdogs.bin";
+
+namespace {
+	const char MAGIC[4] = { 'W', 'R', 'P', 'W' };
+}
+
+bool WatchdogRegistry::Load(const Key& key, std::vector<Item>& items)
+{
+	BinaryReader in(FILENAME);
+	if (!in.readMagic(MAGIC) || in.readInt() != FORMAT_VERSION) return false;
+	Key fileKey;
+	fileKey.processId = static_cast<uint32_t>(in.readInt());
+	in.readBytes(&fileKey.processStart, sizeof(uint64_t));
+	fileKey.globals = in.readInt();
+	if (!in.ok || !(fileKey == key)) return false;
+
+	std::vector<Item> result(in.readCount(2 * sizeof(int)));
+	for (Item& item : result) {
+		item.record = in.readInts();
+		item.state = in.readInts();
+	}
+	if (!in.ok) return false;
+	items = std::move(result);
+	return true;
+}
+
+void WatchdogRegistry::Save(const Key& key, const std::vector<Item>& items)
+{
+	if (items.size() == 0) {
+		std::remove(FILENAME);
+		return;
+	}
+	//Written to a temporary file first, so a crash halfway through can't leave a registry that loads wrong
+	std::string temp = std::string(FILENAME) + ".tmp";
+	{
+		BinaryWriter out(temp.c_str());
+		if (!out.isOpen()) return;
+		out.writeBytes(MAGIC, 4);
+		out.writeInt(FORMAT_VERSION);
+		out.writeInt(static_cast<int>(key.processId));
+		out.writeBytes(&key.processStart, sizeof(uint64_t));
+		out.writeInt(key.globals);
+		out.writeInt(static_cast<int>(items.size()));
+		for (const Item& item : items) {
+			out.writeInts(item.record);
+			out.writeInts(item.state);
+		}
+	}
+	std::remove(FILENAME);
+	std::rename(temp.c_str(), FILENAME);
+}
@@ -0,0 +1,34 @@
+#pragma once
+#include <vector>
+#include <stdint.h>
+
+//The set of running watchdogs, saved to disk so they can be started again if the randomizer is closed and reopened while the game keeps running.
+//Each watchdog is stored as its record (see Watchdog::getRecord) and its runtime state (see Watchdog::getState).
+//The state can point into the game's memory, so a file is only used with the game process it was saved from.
+class WatchdogRegistry
+{
+public:
+	struct Key {
+		uint32_t processId;
+		uint64_t processStart;
+		int globals;
+
+		bool operator==(const Key& other) const {
+			return processId == other.processId && processStart == other.processStart && globals == other.globals;
+		}
+	};
+
+	struct Item {
+		std::vector<int> record;
+		std::vector<int> state;
+	};
+
+	//Returns false if there is no registry file, it is unreadable, or it was saved for another game process
+	static bool Load(const Key& key, std::vector<Item>& items);
+	static void Save(const Key& key, const std::vector<Item>& items);
+
+	static const char* FILENAME;
+
+private:
+	static const int FORMAT_VERSION = 2;
+};
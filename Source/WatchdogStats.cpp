@@ -0,0 +1,110 @@
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+
+// PVS-Studio Static Code Analyzer for C, C++, C#, and Java: http://www.viva64.com
+
+#include "WatchdogStats.h"
+#include <fstream>
+#include <iomanip>
+#include <cmath>
+
+namespace {
+	const char* TYPE_NAMES[] = { "Keep", "Arrow", "Bridge", "Treehouse", "Jungle", "TownDoor" };
+}
+
+void WatchdogStats::enable(const std::string& logFile, float logInterval)
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	_logFile = logFile;
+	_logInterval = std::chrono::milliseconds(static_cast<int>(logInterval * 1000));
+	_started = std::chrono::steady_clock::now();
+	_nextLog = _started + _logInterval;
+	_enabled = true;
+}
+
+void WatchdogStats::recordPoll(size_t bytes)
+{
+	if (!_enabled) return;
+	std::lock_guard<std::mutex> lock(_mutex);
+	_polls++;
+	_pollBytes += bytes;
+}
+
+void WatchdogStats::recordAction(int type, size_t readBytes)
+{
+	if (!_enabled || type < 0 || static_cast<size_t>(type) >= _counters.size()) return;
+	std::lock_guard<std::mutex> lock(_mutex);
+	_counters[type].actions++;
+	_counters[type].readBytes += readBytes;
+}
+
+void WatchdogStats::recordLatency(int type, Duration detect, Duration respond)
+{
+	if (!_enabled || type < 0 || static_cast<size_t>(type) >= _counters.size()) return;
+	std::lock_guard<std::mutex> lock(_mutex);
+	_counters[type].responses++;
+	_counters[type].detect.add(detect);
+	_counters[type].respond.add(respond);
+	_counters[type].total.add(detect + respond);
+}
+
+void WatchdogStats::flush()
+{
+	if (!_enabled) return;
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		if (std::chrono::steady_clock::now() < _nextLog) return;
+		_nextLog += _logInterval;
+	}
+	writeLog();
+}
+
+void WatchdogStats::writeLog()
+{
+	if (!_enabled) return;
+	std::lock_guard<std::mutex> lock(_mutex);
+	std::ofstream out(_logFile, std::ofstream::app);
+	if (!out.is_open()) return;
+	double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - _started).count();
+	out << std::fixed << std::setprecision(2);
+	out << "Watchdog stats after " << elapsed << "s: " << _polls << " polls, " << _pollBytes << " bytes polled" << std::endl;
+	for (size_t i = 0; i < _counters.size(); i++) {
+		const Counters& counters = _counters[i];
+		if (counters.actions == 0) continue;
+		out << "  " << TYPE_NAMES[i] << ": " << counters.actions << " actions, " << counters.readBytes << " bytes read outside polls";
+		if (counters.responses > 0) {
+			out << ", " << counters.responses << " responses (ms) - detect p50 " << counters.detect.percentile(0.5) << " p99 " << counters.detect.percentile(0.99) <<
+				", respond p50 " << counters.respond.percentile(0.5) << " p99 " << counters.respond.percentile(0.99) <<
+				", total p50 " << counters.total.percentile(0.5) << " p99 " << counters.total.percentile(0.99);
+		}
+		out << std::endl;
+	}
+}
+
+void WatchdogStats::Histogram::add(Duration time)
+{
+	long long micros = std::chrono::duration_cast<std::chrono::microseconds>(time).count();
+	int bucket = micros <= 1 ? 0 : static_cast<int>(std::log2(static_cast<double>(micros)) * 4);
+	if (static_cast<size_t>(bucket) >= buckets.size()) bucket = static_cast<int>(buckets.size()) - 1;
+	buckets[bucket]++;
+	count++;
+}
+
+double WatchdogStats::Histogram::percentile(double p) const
+{
+	if (count == 0) return 0;
+	uint32_t rank = static_cast<uint32_t>(std::ceil(p * count));
+	uint32_t seen = 0;
+	for (size_t i = 0; i < buckets.size(); i++) {
+		seen += buckets[i];
+		if (seen >= rank) return std::pow(2.0, (i + 1) / 4.0) / 1000;
+	}
+	return std::pow(2.0, buckets.size() / 4.0) / 1000;
+}
+
+std::atomic<bool> WatchdogStats::_enabled = false;
+std::mutex WatchdogStats::_mutex;
+std::string WatchdogStats::_logFile;
+WatchdogStats::Duration WatchdogStats::_logInterval;
+std::chrono::steady_clock::time_point WatchdogStats::_started, WatchdogStats::_nextLog;
+uint64_t WatchdogStats::_polls = 0, WatchdogStats::_pollBytes = 0;
+std::array<WatchdogStats::Counters, 6> WatchdogStats::_counters;
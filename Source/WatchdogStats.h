@@ -0,0 +1,50 @@
+#pragma once
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <array>
+#include <atomic>
+#include <stdint.h>
+
+//Latency and cost numbers for the watchdogs, appended to a log file so that polling and scheduling changes can be judged on real numbers.
+//Latencies are measured for every traced line change that a watchdog responds to with a write:
+//	detect - from the last read that still saw the old line to the read that saw the change. The most the player can have waited before it was noticed.
+//	respond - from the read that saw the change to the end of the watchdog's write.
+class WatchdogStats
+{
+public:
+	typedef std::chrono::steady_clock::duration Duration;
+
+	//Start collecting. The numbers so far are appended to logFile every logInterval seconds, and when the scheduler stops.
+	static void enable(const std::string& logFile, float logInterval = 60);
+	static bool enabled() { return _enabled; }
+
+	static void recordPoll(size_t bytes);
+	static void recordAction(int type, size_t readBytes);
+	static void recordLatency(int type, Duration detect, Duration respond);
+	static void flush(); //Write the log if it is due
+	static void writeLog();
+
+private:
+	//Counts in buckets a quarter of an octave wide, starting at 1 microsecond. Percentiles are the upper edge of the bucket they fall in.
+	struct Histogram {
+		std::array<uint32_t, 100> buckets = {};
+		uint32_t count = 0;
+
+		void add(Duration time);
+		double percentile(double p) const; //In milliseconds
+	};
+
+	struct Counters {
+		uint64_t actions = 0, readBytes = 0, responses = 0;
+		Histogram detect, respond, total;
+	};
+
+	static std::atomic<bool> _enabled;
+	static std::mutex _mutex;
+	static std::string _logFile;
+	static Duration _logInterval;
+	static std::chrono::steady_clock::time_point _started, _nextLog;
+	static uint64_t _polls, _pollBytes;
+	static std::array<Counters, 6> _counters; //Indexed by Watchdog::Type
+};
@@ -0,0 +1,185 @@
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+
+// PVS-Studio Static Code Analyzer for C, C++, C#, and Java: http://www.viva64.com
+
+#include <windows.h>
+#include "MemoryImage.h"
+#include "PanelStats.h"
+#include "PuzzleList.h"
+#include "Watchdog.h"
+#include <chrono>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <algorithm>
+#include <map>
+#include <cstdio>
+
+//Runs the whole randomizer against a recorded memory image (see MemoryImage) for many seeds, spread over several processes,
+//and reports the panels and seeds that took the longest. Each process handles every processes-th seed, one at a time, so the timings don't compete for cores.
+//Rows with panel 0 hold the time of a whole seed, and rows with panel -1 a seed that failed. All rows are saved to <output>.bin (see PanelStats) and the report to <output>.txt.
+
+namespace {
+	const int TOP = 20;
+
+	void usage() {
+		std::cerr << "Usage: WitnessRandomizerSweep <image> <first seed> <number of seeds> [normal|expert|easy] [processes] [output]" << std::endl;
+	}
+
+	void generate(const std::string& difficulty, int seed) {
+		PuzzleList puzzles;
+		puzzles.setSeed(seed, false, false);
+		puzzles.setThreads(1);
+		if (difficulty == "expert") puzzles.GenerateAllH();
+		else if (difficulty == "easy") puzzles.GenerateAllE();
+		else puzzles.GenerateAllN();
+	}
+
+	//Generate seeds first, first + stride, ... and save the rows to file
+	int runWorker(const std::string& image, const std::string& difficulty, int first, int stride, int count, const std::string& file) {
+		WatchdogScheduler::stop(); //Any watchdog started from here on is dropped - they would only poll the image
+		std::vector<PanelStats::Row> rows;
+		for (int i = 0; i < count; i++) {
+			int seed = first + i * stride;
+			if (!MemoryImage::Load(image.c_str())) return 1; //Fresh copy, without the last seed's writes
+			PanelStats::enable(seed);
+			auto start = std::chrono::steady_clock::now();
+			bool failed = false;
+			try {
+				generate(difficulty, seed);
+			}
+			catch (const std::exception&) {
+				failed = true;
+			}
+			std::vector<PanelStats::Row> seedRows = PanelStats::take();
+			rows.insert(rows.end(), seedRows.begin(), seedRows.end());
+			float millis = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+			rows.push_back({ seed, failed ? -1 : 0, millis, 0, 0, 0 });
+		}
+		return PanelStats::writeColumns(file, rows) ? 0 : 1;
+	}
+
+	bool startProcess(const std::string& commandLine, PROCESS_INFORMATION& process) {
+		STARTUPINFOA startup = {};
+		startup.cb = sizeof(startup);
+		std::string command = commandLine; //CreateProcess may write to it
+		return CreateProcessA(nullptr, &command[0], nullptr, nullptr, FALSE, 0, nullptr, nullptr, &startup, &process);
+	}
+
+	void writeReport(std::ostream& out, const std::vector<PanelStats::Row>& rows) {
+		std::vector<PanelStats::Row> panels, seeds, relaxed;
+		std::vector<int> failed;
+		std::map<int, std::vector<PanelStats::Row>> byPanel;
+		for (const PanelStats::Row& row : rows) {
+			if (row.panel == -1) failed.push_back(row.seed);
+			else if (row.panel == 0) seeds.push_back(row);
+			else {
+				panels.push_back(row);
+				if (row.relaxation > 0) relaxed.push_back(row);
+				byPanel[row.panel].push_back(row);
+			}
+		}
+		auto slower = [](const PanelStats::Row& a, const PanelStats::Row& b) { return a.millis > b.millis; };
+		out << std::fixed << std::setprecision(2);
+		out << seeds.size() << " seeds, " << panels.size() << " panels, " << failed.size() << " failed seeds" << std::endl;
+
+		std::sort(seeds.begin(), seeds.end(), slower);
+		out << std::endl << "Slowest seeds (ms):" << std::endl;
+		for (size_t i = 0; i < seeds.size() && i < TOP; i++) out << "  " << seeds[i].seed << ": " << seeds[i].millis << std::endl;
+
+		std::sort(panels.begin(), panels.end(), slower);
+		out << std::endl << "Slowest panels (seed, panel, ms, attempts, retry depth):" << std::endl;
+		for (size_t i = 0; i < panels.size() && i < TOP; i++) {
+			out << "  " << panels[i].seed << ", 0x" << std::hex << std::setw(5) << std::setfill('0') << panels[i].panel << std::dec << std::setfill(' ') << ", " <<
+				panels[i].millis << ", " << panels[i].attempts << ", " << panels[i].retryDepth << std::endl;
+		}
+
+		//Panels whose worst seeds are much slower than their typical ones are the ones worth optimizing
+		struct Summary { int panel; float p50, p99, max; double meanAttempts; };
+		std::vector<Summary> summaries;
+		for (auto& [panel, list] : byPanel) {
+			std::sort(list.begin(), list.end(), slower);
+			double attempts = 0;
+			for (const PanelStats::Row& row : list) attempts += row.attempts;
+			summaries.push_back({ panel, list[list.size() / 2].millis, list[list.size() / 100].millis, list[0].millis, attempts / list.size() });
+		}
+		std::sort(summaries.begin(), summaries.end(), [](const Summary& a, const Summary& b) { return a.p99 > b.p99; });
+		out << std::endl << "Panels by p99 over all seeds (panel, p50 ms, p99 ms, max ms, mean attempts):" << std::endl;
+		for (size_t i = 0; i < summaries.size() && i < TOP; i++) {
+			const Summary& s = summaries[i];
+			out << "  0x" << std::hex << std::setw(5) << std::setfill('0') << s.panel << std::dec << std::setfill(' ') << ", " << s.p50 << ", " << s.p99 << ", " << s.max << ", " << s.meanAttempts << std::endl;
+		}
+
+		//Every relaxation changes the puzzle a seed makes, so these are listed in full
+		if (relaxed.size() > 0) {
+			out << std::endl << "Relaxed panels (seed, panel, attempts, last step):" << std::endl;
+			for (const PanelStats::Row& row : relaxed) {
+				out << "  " << row.seed << ", 0x" << std::hex << std::setw(5) << std::setfill('0') << row.panel << std::dec << std::setfill(' ') << ", " <<
+					row.attempts << ", " << Generate::relaxationName(static_cast<Generate::Relaxation>(row.relaxation)) << std::endl;
+			}
+		}
+
+		if (failed.size() > 0) {
+			out << std::endl << "Failed seeds:";
+			for (int seed : failed) out << " " << seed;
+			out << std::endl;
+		}
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	if (argc > 1 && std::string(argv[1]) == "--worker") {
+		if (argc < 8) return 1;
+		return runWorker(argv[2], argv[3], atoi(argv[4]), atoi(argv[5]), atoi(argv[6]), argv[7]);
+	}
+	if (argc < 4) {
+		usage();
+		return 1;
+	}
+	std::string image = argv[1];
+	int firstSeed = atoi(argv[2]);
+	int numSeeds = atoi(argv[3]);
+	std::string difficulty = argc > 4 ? argv[4] : "normal";
+	int processes = argc > 5 ? atoi(argv[5]) : static_cast<int>(std::thread::hardware_concurrency());
+	std::string output = argc > 6 ? argv[6] : "WRPGsweep";
+	if (firstSeed <= 0 || numSeeds <= 0 || (difficulty != "normal" && difficulty != "expert" && difficulty != "easy")) {
+		usage();
+		return 1;
+	}
+	processes = max(1, min(processes, numSeeds));
+
+	char exePath[MAX_PATH];
+	GetModuleFileNameA(nullptr, exePath, MAX_PATH);
+	std::vector<PROCESS_INFORMATION> workers(processes);
+	std::vector<std::string> files;
+	auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < processes; i++) {
+		files.push_back(output + ".part" + std::to_string(i) + ".bin");
+		int count = (numSeeds - i + processes - 1) / processes;
+		std::stringstream command;
+		command << "\"" << exePath << "\" --worker \"" << image << "\" " << difficulty << " " << firstSeed + i << " " << processes << " " << count << " \"" << files.back() << "\"";
+		if (!startProcess(command.str(), workers[i])) {
+			std::cerr << "Couldn't start worker process " << i << std::endl;
+			return 1;
+		}
+	}
+
+	std::vector<PanelStats::Row> rows;
+	for (int i = 0; i < processes; i++) {
+		WaitForSingleObject(workers[i].hProcess, INFINITE);
+		CloseHandle(workers[i].hProcess);
+		CloseHandle(workers[i].hThread);
+		if (!PanelStats::readColumns(files[i], rows)) std::cerr << "Worker " << i << " didn't finish - its seeds are missing" << std::endl;
+		std::remove(files[i].c_str());
+	}
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	PanelStats::writeColumns(output + ".bin", rows);
+	std::ofstream report(output + ".txt");
+	writeReport(report, rows);
+	writeReport(std::cout, rows);
+	std::cout << std::endl << numSeeds << " seeds in " << seconds << "s on " << processes << " processes" << std::endl;
+	return 0;
+}
@@ -0,0 +1,194 @@
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+
+// PVS-Studio Static Code Analyzer for C, C++, C#, and Java: http://www.viva64.com
+
+#include "SyntheticPanel.h"
+#include "Watchdog.h"
+#include <iostream>
+#include <random>
+
+//Checks ArrowWatchdog, which updates its checks edge by edge as the traced path changes, against replaying the whole path onto a fresh grid
+//and counting every arrow and triangle again (how it worked before). Runs on synthetic panels (see SyntheticPanel), so it doesn't need the game.
+//Run by ctest; exits with 1 if any check fails.
+
+namespace {
+	int failures = 0;
+
+	void check(bool condition, const std::string& what) {
+		if (condition) return;
+		std::cerr << "FAILED: " << what << std::endl;
+		failures++;
+	}
+
+	struct Layout {
+		int width, height, pillarWidth, style, exitPos;
+		std::vector<std::vector<int>> grid;
+
+		int exitPoint() const { return pillarWidth > 0 ? (width / 2) * (height / 2 + 1) : (width / 2 + 1) * (height / 2 + 1); }
+		int columns() const { return pillarWidth > 0 ? width / 2 : width / 2 + 1; }
+	};
+
+	struct Verdict {
+		bool complete;
+		int failing; //Arrows and triangles whose count is wrong
+	};
+
+	//Replay the whole path onto a copy of the grid, then look at every symbol
+	Verdict replay(const Layout& layout, const std::vector<SolutionPoint>& traced) {
+		int width = layout.width, height = layout.height, pillarWidth = layout.pillarWidth;
+		int exitPoint = layout.exitPoint();
+		int exitPosSym = (width / 2 + 1) * (height / 2 + 1) - 1 - layout.exitPos;
+		std::vector<std::pair<int, int>> points;
+		for (const SolutionPoint& sp : traced) points.emplace_back(sp.pointA, sp.pointB);
+		if (layout.style & Panel::Style::SYMMETRICAL) {
+			for (const SolutionPoint& sp : traced) {
+				if (sp.pointA >= exitPoint || sp.pointB >= exitPoint) points.emplace_back(exitPoint, exitPoint);
+				else points.emplace_back((width / 2 + 1) * (height / 2 + 1) - 1 - sp.pointA, (width / 2 + 1) * (height / 2 + 1) - 1 - sp.pointB);
+			}
+		}
+		std::vector<std::vector<int>> grid = layout.grid;
+		bool complete = false;
+		for (auto [p1, p2] : points) {
+			if (p1 == exitPoint || p2 == exitPoint) {
+				complete = true;
+				continue;
+			}
+			else if (p1 > exitPoint || p2 > exitPoint) continue;
+			if (p1 == 0 && p2 == 0 || p1 < 0 || p2 < 0) break;
+			int columns = layout.columns();
+			int x1 = (p1 % columns) * 2, y1 = height - 1 - (p1 / columns) * 2;
+			int x2 = (p2 % columns) * 2, y2 = height - 1 - (p2 / columns) * 2;
+			grid[x1][y1] = grid[x2][y2] = PATH;
+			if (pillarWidth > 0 && x1 != x2 && x1 != x2 + 2 && x1 != x2 - 2) grid[width - 1][(y1 + y2) / 2] = PATH;
+			else grid[(x1 + x2) / 2][(y1 + y2) / 2] = PATH;
+			if (p1 == layout.exitPos || p2 == layout.exitPos || (layout.style & Panel::Style::SYMMETRICAL) && (p1 == exitPosSym || p2 == exitPosSym)) {
+				complete = !complete;
+			}
+			else complete = false;
+		}
+
+		//Not Point, which wraps x around the pillar the watchdog last set up
+		const std::vector<std::pair<int, int>> directions = { { 0, 2 }, { 0, -2 }, { 2, 0 }, { -2, 0 }, { 2, 2 }, { 2, -2 }, { -2, -2 }, { -2, 2 } };
+		int failing = 0;
+		for (int x = 1; x < width; x++) {
+			for (int y = 1; y < height; y++) {
+				int symbol = grid[x][y];
+				int count = 0, target;
+				if ((symbol & 0x700) == Decoration::Triangle && (symbol & 0xf0000) != 0) {
+					target = symbol >> 16;
+					for (auto [cx, cy] : { std::make_pair(x - 1, y), std::make_pair(x + 1, y), std::make_pair(x, y - 1), std::make_pair(x, y + 1) }) {
+						if (pillarWidth > 0) cx = (cx + pillarWidth) % pillarWidth;
+						if (cx >= 0 && cx < width && cy >= 0 && cy < height && grid[cx][cy] == PATH) count++;
+					}
+				}
+				else if ((symbol & 0x700) == Decoration::Arrow) {
+					target = (symbol & 0xf000) >> 12;
+					std::pair<int, int> dir = directions[(symbol & 0xf0000) >> 16];
+					int cx = pillarWidth > 0 ? (x + dir.first / 2 + pillarWidth) % pillarWidth : x + dir.first / 2, cy = y + dir.second / 2;
+					std::set<std::pair<int, int>> seen;
+					while (cx >= 0 && cx < width && cy >= 0 && cy < height && seen.insert(std::make_pair(cx, cy)).second) {
+						if (grid[cx][cy] == PATH) count++;
+						cx = pillarWidth > 0 ? (cx + dir.first + pillarWidth) % pillarWidth : cx + dir.first;
+						cy += dir.second;
+					}
+				}
+				else continue;
+				if (count != target) failing++;
+			}
+		}
+		return { complete, failing };
+	}
+
+	Layout randomLayout(std::mt19937& rng, int cellsX, int cellsY, bool pillar, bool symmetrical) {
+		Layout layout;
+		layout.width = pillar ? cellsX * 2 : cellsX * 2 + 1;
+		layout.height = cellsY * 2 + 1;
+		layout.pillarWidth = pillar ? layout.width : 0;
+		layout.style = Panel::Style::HAS_TRIANGLES | (symmetrical ? Panel::Style::SYMMETRICAL : 0);
+		layout.grid.assign(layout.width, std::vector<int>(layout.height, 0));
+		for (int x = 1; x < layout.width; x += 2) {
+			for (int y = 1; y < layout.height; y += 2) {
+				int roll = rng() % 10;
+				if (roll < 4) layout.grid[x][y] = Decoration::Arrow | (rng() % 4) << 12 | (rng() % 8) << 16;
+				else if (roll < 6) layout.grid[x][y] = Decoration::Triangle | (1 + rng() % 3) << 16;
+			}
+		}
+		layout.exitPos = (layout.height / 2) * layout.columns() + static_cast<int>(rng() % layout.columns()); //Somewhere on the top row
+		return layout;
+	}
+
+	//Neighbours of a grid point, wrapping around a pillar
+	std::vector<int> neighbours(const Layout& layout, int point) {
+		int columns = layout.columns(), rows = layout.height / 2 + 1;
+		int column = point % columns, row = point / columns;
+		std::vector<int> result;
+		if (row > 0) result.push_back(point - columns);
+		if (row < rows - 1) result.push_back(point + columns);
+		if (layout.pillarWidth > 0) {
+			result.push_back(row * columns + (column + 1) % columns);
+			result.push_back(row * columns + (column + columns - 1) % columns);
+		}
+		else {
+			if (column > 0) result.push_back(point - 1);
+			if (column < columns - 1) result.push_back(point + 1);
+		}
+		return result;
+	}
+
+	SolutionPoint edge(int pointA, int pointB) {
+		SolutionPoint sp = {};
+		sp.pointA = pointA;
+		sp.pointB = pointB;
+		return sp;
+	}
+
+	//A random walk that grows, backs up, starts over, and sometimes reaches the exit or has a bad edge at the end, as a traced line does while the player draws it.
+	//After each change the watchdog is run on it, and has to agree with a replay of the whole path.
+	void runTrace(std::mt19937& rng, const Layout& layout, int steps, const std::string& name) {
+		int id = SyntheticPanel::Create(layout.width / 2, layout.height / 2, layout.pillarWidth > 0);
+		Memory memory("witness64_d3d11.exe");
+		const size_t CAPACITY = 256;
+		memory.WriteArray<SolutionPoint>(id, TRACED_EDGE_DATA, std::vector<SolutionPoint>(CAPACITY), true); //Big enough that the array never moves
+
+		std::vector<int> state = { layout.style, layout.exitPos, layout.pillarWidth, layout.width, layout.height };
+		for (const std::vector<int>& column : layout.grid) state.insert(state.end(), column.begin(), column.end());
+		ArrowWatchdog watchdog(id, layout.pillarWidth, state);
+
+		std::vector<int> walk = { 0 };
+		int mismatches = 0;
+		for (int step = 0; step < steps; step++) {
+			int roll = rng() % 20;
+			if (roll == 0) walk = { static_cast<int>(rng() % layout.exitPoint()) };
+			else if (roll < 5 && walk.size() > 1) walk.resize(walk.size() - 1 - rng() % std::min<size_t>(walk.size() - 1, 3));
+			else if (walk.size() < CAPACITY - 2) {
+				std::vector<int> next = neighbours(layout, walk.back());
+				walk.push_back(next[rng() % next.size()]);
+			}
+			std::vector<SolutionPoint> traced;
+			for (size_t i = 0; i + 1 < walk.size(); i++) traced.push_back(edge(walk[i], walk[i + 1]));
+			int end = rng() % 8;
+			if (end == 0) traced.push_back(edge(walk.back(), layout.exitPoint())); //Onto the exit
+			else if (end == 1) traced.push_back(edge(walk.back(), -1)); //Bad edge, which stops processing
+			if (traced.size() > 0) memory.WriteArray<SolutionPoint>(id, TRACED_EDGE_DATA, traced);
+			memory.WritePanelData<int>(id, TRACED_EDGES, { static_cast<int>(traced.size()) });
+
+			watchdog.initPath();
+			Verdict expected = replay(layout, traced);
+			if (watchdog.complete != expected.complete || watchdog.failing != expected.failing) mismatches++;
+		}
+		check(mismatches == 0, name + ": the incremental check agrees with a replay of the whole path (" + std::to_string(mismatches) + " of " + std::to_string(steps) + " states differ)");
+	}
+}
+
+int main()
+{
+	std::mt19937 rng(1);
+	for (int i = 0; i < 20; i++) {
+		runTrace(rng, randomLayout(rng, 4, 4, false, false), 500, "plain panel " + std::to_string(i));
+		runTrace(rng, randomLayout(rng, 5, 3, false, true), 500, "symmetrical panel " + std::to_string(i));
+		runTrace(rng, randomLayout(rng, 6, 4, true, false), 500, "pillar " + std::to_string(i));
+	}
+	if (failures > 0) return 1;
+	std::cout << "All checks passed" << std::endl;
+	return 0;
+}
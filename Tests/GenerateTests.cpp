@@ -0,0 +1,143 @@
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+
+// PVS-Studio Static Code Analyzer for C, C++, C#, and Java: http://www.viva64.com
+
+#include "SyntheticPanel.h"
+#include "Generate.h"
+#include <iostream>
+#include <functional>
+
+//Checks of Generate on synthetic panels (see SyntheticPanel), so they run without the game. Run by ctest; exits with 1 if any check fails.
+
+namespace {
+	int failures = 0;
+
+	void check(bool condition, const std::string& what) {
+		if (condition) return;
+		std::cerr << "FAILED: " << what << std::endl;
+		failures++;
+	}
+
+	//Every config flag, since _config itself is private
+	std::vector<bool> flags(Generate& gen) {
+		std::vector<bool> result;
+		for (int i = 0; i < 32; i++) result.push_back(gen.hasFlag(static_cast<Generate::Config>(1u << i)));
+		return result;
+	}
+
+	//The ShorterPath step takes LongestPath away for one panel. LongPath isn't set, so it mustn't be set afterwards either.
+	void relaxedGenerationKeepsConfig() {
+		int id = SyntheticPanel::Create(4, 4);
+		Generate gen;
+		gen.seed(1);
+		gen.setFlag(Generate::Config::LongestPath);
+		std::vector<bool> before = flags(gen);
+		Generate::attempts = 0;
+		gen.generate(id, Decoration::Stone | Decoration::Color::Black, 20); //More stones than the grid has cells, so it only works once relaxed
+		check(Generate::attempts > 2000, "generation needed the relaxation ladder");
+		check(flags(gen) == before, "config is the same before and after a relaxed generation");
+	}
+
+	//Rotational symmetry maps the only start onto the only exit, so no path exists. It has to fail instead of looping forever.
+	void impossibleMazeThrows() {
+		int id = SyntheticPanel::Create(4, 4);
+		Generate gen;
+		gen.seed(1);
+		gen.setSymmetry(Panel::Symmetry::Rotational);
+		bool threw = false;
+		try {
+			gen.generateMaze(id);
+		}
+		catch (const std::runtime_error&) {
+			threw = true;
+		}
+		check(threw, "an impossible maze throws runtime_error");
+	}
+}
+
+class GenerateTests
+{
+public:
+	//Everything a failed stage has to put back
+	struct State {
+		std::vector<std::vector<int>> grid;
+		std::set<Point> openpos;
+		int stoneTypes, config, oneTimeAdd, oneTimeRemove, style;
+		bool bisect;
+
+		bool operator==(const State& other) const {
+			return grid == other.grid && openpos == other.openpos && stoneTypes == other.stoneTypes && config == other.config &&
+				oneTimeAdd == other.oneTimeAdd && oneTimeRemove == other.oneTimeRemove && style == other.style && bisect == other.bisect;
+		}
+	};
+
+	static State state(Generate& gen) {
+		return { gen._panel->_grid, gen._openpos, gen._stoneTypes, gen._config, gen._oneTimeAdd, gen._oneTimeRemove, gen._panel->_style, gen._bisect };
+	}
+
+	//A stage that places symbols and changes the flags, then fails. Every retry, and whatever runs after the stages, has to see the panel exactly as the stage found it.
+	static void failedStageRollsBack() {
+		int id = SyntheticPanel::Create(5, 5);
+		Generate gen;
+		gen.seed(3);
+		gen.setFlag(Generate::Config::ShortPath);
+		gen.initPanel(id);
+		gen._parity = -1;
+		for (int i = 0; i < 20; i++) {
+			gen.clear();
+			if (gen.generate_path_length(6)) break;
+		}
+		check(gen._path.size() > 0, "a path was made to place symbols around");
+		gen._stoneTypes = 2;
+		gen._bisect = false;
+
+		std::vector<State> starts;
+		bool firstPlaced = false;
+		std::vector<Generate::Stage> stages = {
+			{ StageStats::Stones, [&] { return firstPlaced = gen.place_dots(3, 0, false); } },
+			{ StageStats::Dots, [&] {
+				starts.push_back(state(gen));
+				gen.place_stones(Decoration::Color::White, 2);
+				gen.place_dots(2, 0, false);
+				gen.setFlagOnce(Generate::Config::LongestPath);
+				gen.removeFlagOnce(Generate::Config::ShortPath);
+				gen._stoneTypes++;
+				gen._bisect = true;
+				gen._panel->_style |= Panel::Style::HAS_DOTS;
+				return false;
+			} },
+		};
+		check(!gen.run_stages(stages), "the stages fail when one stage always fails");
+		check(firstPlaced, "the stage before the failing one placed its dots");
+		check(starts.size() == Generate::STAGE_RETRIES + 1, "the failing stage is retried STAGE_RETRIES times");
+		bool same = starts.size() > 0;
+		for (const State& start : starts) same = same && start == starts[0];
+		check(same, "every retry starts from the same grid, open cells and flags");
+		check(starts.size() > 0 && state(gen) == starts[0], "the failed stage is rolled back to where it started");
+		check(gen._trail.size() == 0 && !gen._trailing, "the undo trail is cleared and off after the stages");
+
+		//A stage that fails once and then works keeps only what its second run did
+		std::vector<Generate::Stage> retry = {
+			{ StageStats::Stones, [&] {
+				starts.push_back(state(gen));
+				gen.setFlagOnce(Generate::Config::SmallShapes);
+				gen.place_stones(Decoration::Color::White, 1);
+				return starts.size() > Generate::STAGE_RETRIES + 2;
+			} },
+		};
+		State before = state(gen);
+		check(gen.run_stages(retry), "a stage that works on its second run succeeds");
+		check(starts.back() == before, "the second run starts from the state before the first");
+		check(gen.hasFlag(Generate::Config::SmallShapes) && state(gen).grid != before.grid, "what the successful run did is kept");
+	}
+};
+
+int main()
+{
+	relaxedGenerationKeepsConfig();
+	impossibleMazeThrows();
+	GenerateTests::failedStageRollsBack();
+	if (failures > 0) return 1;
+	std::cout << "All checks passed" << std::endl;
+	return 0;
+}
@@ -0,0 +1,119 @@
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+
+// PVS-Studio Static Code Analyzer for C, C++, C#, and Java: http://www.viva64.com
+
+#include "Panel.h"
+#include "MemoryImage.h"
+#include <iostream>
+#include <random>
+
+//Checks Panel's segment index (index_segments/locate_segment) against searching every connection, as segments get broken for dots and gaps.
+//Run by ctest; exits with 1 if any check fails.
+
+namespace {
+	int failures = 0;
+
+	void check(bool condition, const std::string& what) {
+		if (condition) return;
+		std::cerr << "FAILED: " << what << std::endl;
+		failures++;
+	}
+}
+
+class PanelSegmentTests
+{
+public:
+	//The connection spanning segment (x, y), found by decoding every connection. First match wins.
+	static int linearSearch(Panel& panel, int x, int y, const std::vector<int>& connections_a, const std::vector<int>& connections_b) {
+		int pillarWidth = Point::pillarWidth;
+		for (size_t i = 0; i < connections_a.size(); i++) {
+			auto [x1, y1] = panel.loc_to_xy(connections_a[i]);
+			auto [x2, y2] = panel.loc_to_xy(connections_b[i]);
+			if (y1 == y - 1 && y2 == y + 1 && x1 == x && x2 == x) return static_cast<int>(i);
+			if (pillarWidth) {
+				if (x1 == (x - 1 + pillarWidth) % pillarWidth && x2 == (x + 1) % pillarWidth && y1 == y && y2 == y) return static_cast<int>(i);
+			}
+			else if (x1 == x - 1 && x2 == x + 1 && y1 == y && y2 == y) return static_cast<int>(i);
+		}
+		return -1;
+	}
+
+	//A random grid with some segments missing, connected the way WriteIntersections does it. Then random segments are looked up and broken,
+	//and every lookup has to agree with the linear search.
+	static int checkGrid(std::mt19937& rng, int cellsX, int cellsY, bool pillar) {
+		Panel panel;
+		panel._width = pillar ? cellsX * 2 : cellsX * 2 + 1;
+		panel._height = cellsY * 2 + 1;
+		panel._grid.assign(panel._width, std::vector<int>(panel._height, 0));
+		panel.minx = panel.miny = 0.1f;
+		panel.unitWidth = panel.unitHeight = 0.1f;
+		Point::pillarWidth = pillar ? panel._width : 0;
+		for (int x = 0; x < panel._width; x++) {
+			for (int y = 0; y < panel._height; y++) {
+				if (x % 2 != y % 2 && rng() % 6 == 0) panel._grid[x][y] = OPEN;
+			}
+		}
+
+		std::vector<int> connections_a, connections_b, intersectionFlags;
+		std::vector<float> intersections;
+		for (int y = panel._height - 1; y >= 0; y -= 2) {
+			for (int x = 0; x < panel._width; x += 2) {
+				intersections.push_back(0);
+				intersections.push_back(0);
+				intersectionFlags.push_back(IntersectionFlags::INTERSECTION);
+				if (y > 0 && panel._grid[x][y - 1] != OPEN) {
+					connections_a.push_back(panel.xy_to_loc(x, y - 2));
+					connections_b.push_back(panel.xy_to_loc(x, y));
+				}
+				if (x > 0 && panel._grid[x - 1][y] != OPEN) {
+					connections_a.push_back(panel.xy_to_loc(x - 2, y));
+					connections_b.push_back(panel.xy_to_loc(x, y));
+				}
+			}
+			if (pillar && panel._grid[panel._width - 1][y] != OPEN) {
+				connections_a.push_back(panel.xy_to_loc(panel._width - 2, y));
+				connections_b.push_back(panel.xy_to_loc(0, y));
+			}
+		}
+		panel.index_segments(connections_a, connections_b);
+
+		int lookups = 0;
+		for (int step = 0; step < 200; step++) {
+			int x = static_cast<int>(rng() % panel._width), y = static_cast<int>(rng() % panel._height);
+			if (pillar && rng() % 4 == 0) x = -1; //The segment across the seam, from the left of the first column
+			int expected = linearSearch(panel, x, y, connections_a, connections_b);
+			int found = panel.locate_segment(x, y);
+			lookups++;
+			if (found != expected) {
+				check(false, std::string(pillar ? "pillar" : "grid") + " segment (" + std::to_string(x) + ", " + std::to_string(y) + ") is connection " +
+					std::to_string(expected) + ", index says " + std::to_string(found));
+				return lookups;
+			}
+			if (found == -1 || rng() % 3 == 0) continue;
+			int wx = (x + panel._width) % panel._width;
+			if (rng() % 2) panel.break_segment(wx, y, connections_a, connections_b, intersections, intersectionFlags);
+			else {
+				if (rng() % 2) panel._grid[wx][y] |= IntersectionFlags::GAP;
+				panel.break_segment_gap(wx, y, connections_a, connections_b, intersections, intersectionFlags);
+			}
+			check(panel.locate_segment(x, y) == -1 && linearSearch(panel, x, y, connections_a, connections_b) == -1, "a broken segment isn't found any more");
+		}
+		Point::pillarWidth = 0;
+		return lookups;
+	}
+};
+
+int main()
+{
+	MemoryImage::LoadBlank(0x1000); //Panel wants a Memory, though nothing here reads or writes the game
+	std::mt19937 rng(1);
+	int lookups = 0;
+	for (int i = 0; i < 300 && failures == 0; i++) {
+		int cellsX = 1 + static_cast<int>(rng() % 7), cellsY = 1 + static_cast<int>(rng() % 7);
+		lookups += PanelSegmentTests::checkGrid(rng, cellsX, cellsY, false);
+		lookups += PanelSegmentTests::checkGrid(rng, cellsX + 1, cellsY, true); //Pillars are at least 2 columns wide
+	}
+	if (failures > 0) return 1;
+	std::cout << "All checks passed (" << lookups << " lookups)" << std::endl;
+	return 0;
+}
@@ -0,0 +1,90 @@
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+
+// PVS-Studio Static Code Analyzer for C, C++, C#, and Java: http://www.viva64.com
+
+#include "SyntheticPanel.h"
+#include "PuzzleList.h"
+#include "Memory.h"
+#include <iostream>
+#include <algorithm>
+
+//Checks of PuzzleList::GenerateAreas on synthetic panels (see SyntheticPanel), so they run without the game. Run by ctest; exits with 1 if any check fails.
+
+namespace {
+	int failures = 0;
+
+	void check(bool condition, const std::string& what) {
+		if (condition) return;
+		std::cerr << "FAILED: " << what << std::endl;
+		failures++;
+	}
+
+	//The staging image is in the order the writes happened, which depends on how the tasks were scheduled
+	void sortWrites(std::vector<Memory::StagedWrite>& writes) {
+		std::stable_sort(writes.begin(), writes.end(), [](const Memory::StagedWrite& a, const Memory::StagedWrite& b) {
+			return a.panel != b.panel ? a.panel < b.panel : a.offset < b.offset;
+		});
+	}
+
+	bool sameWrites(std::vector<Memory::StagedWrite> a, std::vector<Memory::StagedWrite> b) {
+		sortWrites(a);
+		sortWrites(b);
+		if (a.size() != b.size()) return false;
+		for (size_t i = 0; i < a.size(); i++) {
+			if (a[i].panel != b[i].panel || a[i].offset != b[i].offset || a[i].isArray != b[i].isArray || a[i].data != b[i].data) return false;
+		}
+		return true;
+	}
+}
+
+class PuzzleListTests
+{
+public:
+	//A few areas of synthetic panels, generated with the given number of threads. Returns everything written to the panels.
+	static std::vector<Memory::StagedWrite> generateAreas(const std::vector<std::vector<int>>& areaIds, int threads) {
+		PuzzleList puzzles;
+		puzzles.setSeed(1234, false, false);
+		puzzles.setThreads(threads);
+		puzzles.setWriteMode(PuzzleList::WriteMode::Direct); //The writes land in the staging image set up below instead
+		Random::seedPanels(puzzles.baseSeed, Random::Difficulty::Normal);
+		std::vector<std::pair<std::wstring, PuzzleList::AreaFunc>> areas;
+		for (size_t i = 0; i < areaIds.size(); i++) {
+			std::vector<int> ids = areaIds[i];
+			areas.push_back({ L"Area " + std::to_wstring(i), [ids](PuzzleList* list) {
+				for (int id : ids) {
+					list->generator->resetConfig();
+					list->generator->generate(id, Decoration::Stone | Decoration::Color::Black, 3, Decoration::Stone | Decoration::Color::White, 3, Decoration::Dot, 2);
+				}
+			} });
+		}
+		Memory::BeginStaging();
+		puzzles.GenerateAreas(Random::Difficulty::Normal, areas);
+		std::vector<Memory::StagedWrite> writes = Memory::GetStagedWrites();
+		Memory::DiscardStaging(); //So the next run starts from the same blank panels
+		return writes;
+	}
+
+	//Each area task reseeds from its name, so how many of them run at once mustn't change the puzzles
+	static void threadCountDoesntChangePuzzles() {
+		std::vector<std::vector<int>> areaIds;
+		for (int area = 0; area < 6; area++) {
+			std::vector<int> ids;
+			for (int i = 0; i < 3; i++) ids.push_back(SyntheticPanel::Create(4 + i % 2, 4, area == 5 && i == 0));
+			areaIds.push_back(ids);
+		}
+		std::vector<Memory::StagedWrite> oneThread = generateAreas(areaIds, 1);
+		check(oneThread.size() > 0, "generating the areas writes the panels");
+		for (int threads : { 2, 4, 6 }) {
+			check(sameWrites(generateAreas(areaIds, threads), oneThread), "the same writes with " + std::to_string(threads) + " threads as with 1");
+		}
+		check(sameWrites(generateAreas(areaIds, 1), oneThread), "the same writes when generating again with 1 thread");
+	}
+};
+
+int main()
+{
+	PuzzleListTests::threadCountDoesntChangePuzzles();
+	if (failures > 0) return 1;
+	std::cout << "All checks passed" << std::endl;
+	return 0;
+}
@@ -0,0 +1,100 @@
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+
+// PVS-Studio Static Code Analyzer for C, C++, C#, and Java: http://www.viva64.com
+
+#include "PuzzleSymbols.h"
+#include <iostream>
+#include <map>
+#include <cmath>
+
+//Checks of PuzzleSymbols::popRandomSymbol and the weights behind it. Run by ctest; exits with 1 if any check fails.
+
+namespace {
+	int failures = 0;
+
+	void check(bool condition, const std::string& what) {
+		if (condition) return;
+		std::cerr << "FAILED: " << what << std::endl;
+		failures++;
+	}
+
+	bool throwsWhenEmpty(PuzzleSymbols& symbols) {
+		try {
+			symbols.popRandomSymbol();
+		}
+		catch (const std::runtime_error&) {
+			return true;
+		}
+		return false;
+	}
+
+	//Each class with symbols is equally likely, then each variant in it. Erasers, starts, exits and amounts of 25 or more are never picked.
+	void firstPickDistribution() {
+		const PuzzleSymbols start({ { Decoration::Stone | Decoration::Color::Black, 3 }, { Decoration::Stone | Decoration::Color::White, 3 },
+			{ Decoration::Star | Decoration::Color::Black, 2 }, { Decoration::Dot, 5 }, { Decoration::Triangle, 25 },
+			{ Decoration::Eraser | Decoration::Color::White, 1 }, { Decoration::Start, 1 }, { Decoration::Exit, 1 } });
+		std::map<int, double> expected = { { Decoration::Stone | Decoration::Color::Black, 1 / 6.0 }, { Decoration::Stone | Decoration::Color::White, 1 / 6.0 },
+			{ Decoration::Star | Decoration::Color::Black, 1 / 3.0 }, { Decoration::Dot, 1 / 3.0 } };
+		const int draws = 60000;
+		std::map<int, int> picks;
+		Random::seed(1);
+		for (int i = 0; i < draws; i++) {
+			PuzzleSymbols symbols = start;
+			picks[symbols.popRandomSymbol()]++;
+		}
+		for (const auto& [symbol, count] : picks) {
+			check(expected.count(symbol) > 0, "symbol " + std::to_string(symbol) + " can be picked");
+		}
+		for (const auto& [symbol, probability] : expected) {
+			double share = static_cast<double>(picks[symbol]) / draws;
+			check(std::abs(share - probability) < 0.01, "symbol " + std::to_string(symbol) + " is picked " + std::to_string(share) + " of the time, expected " + std::to_string(probability));
+		}
+	}
+
+	//Once a variant runs out it isn't picked again, and once everything has run out popRandomSymbol throws
+	void exhaustedVariants() {
+		Random::seed(2);
+		for (int trial = 0; trial < 200; trial++) {
+			PuzzleSymbols symbols({ { Decoration::Stone | Decoration::Color::Black, 1 }, { Decoration::Stone | Decoration::Color::White, 4 }, { Decoration::Dot, 2 }, { Decoration::Dot_Intersection, 25 } });
+			std::map<int, int> picks;
+			for (int i = 0; i < 7; i++) picks[symbols.popRandomSymbol()]++;
+			bool exact = picks.size() == 3 && picks[Decoration::Stone | Decoration::Color::Black] == 1 && picks[Decoration::Stone | Decoration::Color::White] == 4 && picks[Decoration::Dot] == 2;
+			check(exact, "popping everything takes each variant exactly as many times as it has symbols");
+			check(symbols.getNum(Decoration::Stone) == 0 && symbols.getNum(Decoration::Dot) == 25, "popped symbols are taken off the amounts");
+			check(throwsWhenEmpty(symbols), "popping with nothing left throws");
+			if (failures > 0) return;
+		}
+	}
+
+	//Changing the lists through operator[] or removeOne has to be seen by the next pick, even after the weights were built
+	void rebuildAfterDirectChanges() {
+		Random::seed(3);
+		for (int trial = 0; trial < 200; trial++) {
+			PuzzleSymbols symbols({ { Decoration::Stone | Decoration::Color::Black, 5 }, { Decoration::Stone | Decoration::Color::White, 5 } });
+			symbols.popRandomSymbol(); //Builds the weights
+			symbols[Decoration::Stone][0].second = 0;
+			for (int i = 0; i < 3; i++) check(symbols.popRandomSymbol() == (Decoration::Stone | Decoration::Color::White), "a variant set to 0 directly isn't picked");
+
+			symbols[Decoration::Star].push_back({ Decoration::Star | Decoration::Color::Orange, 1 });
+			symbols[Decoration::Stone][1].second = 0;
+			check(symbols.popRandomSymbol() == (Decoration::Star | Decoration::Color::Orange), "a variant added directly is picked");
+			check(throwsWhenEmpty(symbols), "nothing left after the added variant is used up");
+
+			PuzzleSymbols last({ { Decoration::Dot, 1 }, { Decoration::Triangle, 1 } });
+			last.popRandomSymbol();
+			check(last.removeOne(), "removeOne finds a symbol to take");
+			check(throwsWhenEmpty(last), "a symbol taken by removeOne isn't picked");
+			if (failures > 0) return;
+		}
+	}
+}
+
+int main()
+{
+	firstPickDistribution();
+	exhaustedVariants();
+	rebuildAfterDirectChanges();
+	if (failures > 0) return 1;
+	std::cout << "All checks passed" << std::endl;
+	return 0;
+}